@@ -0,0 +1,111 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+// Encode and decode position messages with the archive buffers, without
+// network, and compare with the former text path going through string streams.
+
+#include <neev/buffer/archive_buffer.hpp>
+#include <boost/asio/buffer.hpp>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "position/position.hpp"
+
+using namespace neev;
+
+static const std::size_t iterations = 200000;
+
+// Copy the frame in the chunks of the receive buffer, as a socket would do.
+template <class ReceiveBuffer>
+void receive_frame(ReceiveBuffer& receiver, const std::string& frame)
+{
+  std::size_t offset = 0;
+  while(true)
+  {
+    auto chunk = receiver.chunk();
+    std::size_t n = boost::asio::buffer_size(chunk);
+    std::memcpy(boost::asio::buffer_cast<char*>(chunk), frame.data() + offset, n);
+    offset += n;
+    if(!receiver.has_next_chunk())
+      break;
+    receiver.next_chunk();
+  }
+}
+
+// Concatenate the buffers of the chunk, as a gathered write sends them.
+template <class SendBuffer>
+std::string gather_frame(const SendBuffer& sender)
+{
+  std::string frame;
+  for(const auto& buffer : sender.chunk())
+  {
+    frame.append(boost::asio::buffer_cast<const char*>(buffer), boost::asio::buffer_size(buffer));
+  }
+  return frame;
+}
+
+// The text path before the archive policies: serialize in an ostringstream,
+// copy it in a string, then copy it again in an istringstream to decode it.
+std::int64_t string_stream_path(const position& pos)
+{
+  std::int64_t checksum = 0;
+  for(std::size_t i = 0; i < iterations; ++i)
+  {
+    std::ostringstream output;
+    {
+      boost::archive::text_oarchive archive(output);
+      archive << pos;
+    }
+    std::string payload = output.str();
+    prefixed_send_buffer<std::uint32_t> sender(std::move(payload));
+
+    prefixed_receive_buffer<std::uint32_t> receiver;
+    receive_frame(receiver, gather_frame(sender));
+    std::istringstream input(receiver.data());
+    boost::archive::text_iarchive archive(input);
+    position decoded;
+    archive >> decoded;
+    checksum += decoded.x + decoded.y + decoded.z;
+  }
+  return checksum;
+}
+
+template <class Archive>
+std::int64_t archive_path(const position& pos)
+{
+  std::int64_t checksum = 0;
+  for(std::size_t i = 0; i < iterations; ++i)
+  {
+    archive_send_buffer<position, std::uint32_t, Archive> sender(pos);
+    archive_receive_buffer<position, std::uint32_t, Archive> receiver;
+    receive_frame(receiver, gather_frame(sender));
+    const position& decoded = receiver.data();
+    checksum += decoded.x + decoded.y + decoded.z;
+  }
+  return checksum;
+}
+
+template <class F>
+void run(const char* name, F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  std::int64_t checksum = f();
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  std::cout << name << ": " << elapsed / iterations << " ns/message"
+            << " (checksum " << checksum << ")" << std::endl;
+}
+
+int main()
+{
+  position pos(1024, -42, 65536);
+  run("text, string streams", [&]{ return string_stream_path(pos); });
+  run("text_archive        ", [&]{ return archive_path<text_archive>(pos); });
+  run("binary_archive      ", [&]{ return archive_path<binary_archive>(pos); });
+  return 0;
+}
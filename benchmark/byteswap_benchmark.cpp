@@ -0,0 +1,65 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+// Convert arrays to network byte order element by element (mhton) and with
+// the bulk conversion (mhton_array).
+
+#include <neev/network_converter.hpp>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+static const std::size_t elements = 1 << 20;
+static const std::size_t rounds = 200;
+
+template <class F>
+double measure(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  for(std::size_t r = 0; r < rounds; ++r)
+  {
+    f();
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  return static_cast<double>(elapsed) / (rounds * elements);
+}
+
+template <class T>
+void run(const char* name)
+{
+  std::vector<T> data(elements);
+  for(std::size_t i = 0; i < elements; ++i)
+  {
+    data[i] = static_cast<T>(i * 2654435761u);
+  }
+  double scalar = measure([&]{
+    for(T& value : data)
+    {
+      neev::mhton(value);
+    }
+  });
+  double bulk = measure([&]{
+    neev::mhton_array(data.data(), data.size());
+  });
+  // Use the result so the loops are not optimized away.
+  std::uint64_t sum = 0;
+  for(const T& value : data)
+  {
+    sum += static_cast<std::uint64_t>(value);
+  }
+  std::cout << name << ": scalar " << scalar << " ns/element, bulk " << bulk
+            << " ns/element, speedup " << scalar / bulk
+            << " (checksum " << sum << ")" << std::endl;
+}
+
+int main()
+{
+  run<std::uint16_t>("uint16");
+  run<std::uint32_t>("uint32");
+  run<std::uint64_t>("uint64");
+  return 0;
+}
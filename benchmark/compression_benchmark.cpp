@@ -0,0 +1,155 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+// Send state frames over a TCP loopback connection, one after the other,
+// with the prefixed buffers and with the compressed buffers at several levels.
+// Report the throughput of the payload and the number of bytes on the wire.
+
+#include <neev/buffer/prefixed_buffer.hpp>
+#include <neev/buffer/compressed_buffer.hpp>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "position/position.hpp"
+
+using boost::asio::ip::tcp;
+using socket_ptr = std::shared_ptr<tcp::socket>;
+
+static const std::size_t frames = 20000;
+static const std::size_t positions_per_frame = 256;
+
+// A game state: positions of entities moving slowly, formatted as text.
+std::string make_state(std::size_t seed)
+{
+  std::string state;
+  for(std::size_t i = 0; i < positions_per_frame; ++i)
+  {
+    position pos(static_cast<std::int32_t>(i * 10 + seed % 7),
+                 static_cast<std::int32_t>(i * 3),
+                 static_cast<std::int32_t>(100 + seed % 3));
+    state += "entity " + std::to_string(i) + " at (" + std::to_string(pos.x) + ","
+      + std::to_string(pos.y) + "," + std::to_string(pos.z) + ");";
+  }
+  return state;
+}
+
+struct benchmark_state
+{
+  socket_ptr sender;
+  socket_ptr receiver;
+  std::size_t received = 0;
+  std::size_t payload_bytes = 0;
+  std::size_t wire_bytes = 0;
+  int level = 0;
+  bool compressed = false;
+};
+
+void send_next(benchmark_state& state);
+
+struct sender_observer
+{
+  using events_type = neev::events<neev::transfer_error>;
+  void transfer_error(const boost::system::error_code& error)
+  {
+    std::cerr << "send: " << error.message() << std::endl;
+  }
+};
+
+template <class Data>
+struct receiver_observer
+{
+  using events_type = neev::events<neev::transfer_complete, neev::transfer_error, neev::transfer_on_going>;
+  benchmark_state& state;
+  std::size_t frame_size;
+
+  // The full size is known once the prefix is received.
+  void transfer_on_going(std::size_t, boost::optional<std::size_t> full_size)
+  {
+    if(full_size)
+    {
+      frame_size = *full_size;
+    }
+  }
+
+  void transfer_complete(Data& data, neev::receive_op)
+  {
+    state.payload_bytes += data.size();
+    state.wire_bytes += frame_size;
+    if(++state.received < frames)
+    {
+      send_next(state);
+    }
+    else
+    {
+      state.receiver->close();
+    }
+  }
+
+  void transfer_error(const boost::system::error_code& error)
+  {
+    if(state.received < frames)
+      std::cerr << "receive: " << error.message() << std::endl;
+  }
+};
+
+void send_next(benchmark_state& state)
+{
+  std::string frame = make_state(state.received);
+  if(state.compressed)
+  {
+    neev::make_transfer<neev::compressed32_buffer<neev::send_op>>(
+      state.sender, sender_observer(), std::move(frame), state.level)->async_transfer();
+  }
+  else
+  {
+    neev::make_transfer<neev::prefixed32_buffer<neev::send_op>>(state.sender, sender_observer(), std::move(frame))->async_transfer();
+  }
+}
+
+void run(const char* name, bool compressed, int level)
+{
+  boost::asio::io_service io_service;
+  tcp::acceptor acceptor(io_service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+  benchmark_state state;
+  state.sender = std::make_shared<tcp::socket>(io_service);
+  state.receiver = std::make_shared<tcp::socket>(io_service);
+  state.sender->connect(acceptor.local_endpoint());
+  acceptor.accept(*state.receiver);
+  state.sender->set_option(tcp::no_delay(true));
+  state.compressed = compressed;
+  state.level = level;
+
+  auto start = std::chrono::steady_clock::now();
+  if(compressed)
+  {
+    neev::make_transfer<neev::compressed32_buffer<neev::receive_op>>(state.receiver,
+      receiver_observer<neev::pooled_bytes>{state, 0})->async_receive_loop();
+  }
+  else
+  {
+    neev::make_transfer<neev::prefixed32_buffer<neev::receive_op>>(state.receiver,
+      receiver_observer<std::string>{state, 0})->async_receive_loop();
+  }
+  send_next(state);
+  io_service.run();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << name << ": " << state.payload_bytes / seconds / (1024 * 1024) << " MiB/s of payload, "
+            << "ratio " << static_cast<double>(state.payload_bytes) / state.wire_bytes
+            << " (" << state.wire_bytes / frames << " bytes/frame on the wire)" << std::endl;
+}
+
+int main()
+{
+  run("prefixed      ", false, 0);
+  run("compressed, 1 ", true, 1);
+  run("compressed, 6 ", true, 6);
+  run("compressed, 9 ", true, 9);
+  return 0;
+}
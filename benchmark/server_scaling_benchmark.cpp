@@ -0,0 +1,160 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+// Echo servers over TCP loopback, with server_mt (threads sharing an io_service)
+// and server_per_core (one io_service per thread), from 1 thread to one per core.
+// Clients keep a small message in flight on each connection, report the number
+// of round trips per second.
+
+#include <neev/buffer/prefixed_buffer.hpp>
+#include <neev/server/server_mt.hpp>
+#include <neev/server/server_per_core.hpp>
+#include <boost/asio.hpp>
+#include <boost/thread/thread.hpp>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using boost::asio::ip::tcp;
+using socket_ptr = std::shared_ptr<tcp::socket>;
+
+static const std::size_t connections = 64;
+static const std::size_t message_size = 64;
+static const std::chrono::seconds duration(2);
+
+struct quiet_observer
+{
+  using events_type = neev::events<>;
+};
+
+struct echo_observer
+{
+  using events_type = neev::events<neev::transfer_complete>;
+  socket_ptr socket;
+
+  void transfer_complete(std::string& message, neev::receive_op)
+  {
+    neev::make_transfer<neev::prefixed16_buffer<neev::send_op>>(socket, quiet_observer(),
+      std::move(message))->async_transfer();
+  }
+};
+
+struct server_observer
+{
+  using events_type = neev::events<neev::new_client, neev::start_success>;
+  tcp::endpoint* endpoint;
+
+  void start_success(const tcp::endpoint& listening)
+  {
+    *endpoint = listening;
+  }
+
+  void new_client(const socket_ptr& socket)
+  {
+    socket->set_option(tcp::no_delay(true));
+    neev::make_transfer<neev::prefixed16_buffer<neev::receive_op>>(socket,
+      echo_observer{socket})->async_receive_loop();
+  }
+};
+
+struct client_state
+{
+  std::atomic<bool> running;
+  std::atomic<std::size_t> round_trips;
+};
+
+void ping(const socket_ptr& socket)
+{
+  neev::make_transfer<neev::prefixed16_buffer<neev::send_op>>(socket, quiet_observer(),
+    std::string(message_size, 'p'))->async_transfer();
+}
+
+struct client_observer
+{
+  using events_type = neev::events<neev::transfer_complete>;
+  socket_ptr socket;
+  client_state& state;
+
+  void transfer_complete(std::string&, neev::receive_op)
+  {
+    ++state.round_trips;
+    if(state.running)
+    {
+      ping(socket);
+    }
+  }
+};
+
+template <class Server>
+double round_trips_per_second(std::size_t threads, const std::string& port)
+{
+  tcp::endpoint endpoint;
+  Server server(server_observer{&endpoint}, threads);
+  server.start(port);
+  std::thread server_thread([&server]{ server.run(); });
+
+  client_state state;
+  state.running = true;
+  state.round_trips = 0;
+  std::unique_ptr<boost::asio::io_service> client_io(new boost::asio::io_service);
+  for(std::size_t i = 0; i < connections; ++i)
+  {
+    socket_ptr socket = std::make_shared<tcp::socket>(*client_io);
+    socket->connect(endpoint);
+    socket->set_option(tcp::no_delay(true));
+    neev::make_transfer<neev::prefixed16_buffer<neev::receive_op>>(socket,
+      client_observer{socket, state})->async_receive_loop();
+    ping(socket);
+  }
+
+  std::vector<std::thread> clients;
+  for(std::size_t i = 0; i < threads; ++i)
+  {
+    clients.emplace_back([&client_io]{ client_io->run(); });
+  }
+
+  std::this_thread::sleep_for(duration);
+  std::size_t round_trips = state.round_trips;
+  state.running = false;
+  client_io->stop();
+  for(std::thread& client : clients)
+  {
+    client.join();
+  }
+  // Closes the client connections.
+  client_io.reset();
+
+  server.stop();
+  server_thread.join();
+  return round_trips / std::chrono::duration<double>(duration).count();
+}
+
+int main()
+{
+  std::size_t cores = boost::thread::hardware_concurrency();
+  std::vector<std::size_t> thread_counts;
+  for(std::size_t threads = 1; threads < cores; threads *= 2)
+  {
+    thread_counts.push_back(threads);
+  }
+  thread_counts.push_back(cores);
+
+  std::cout << "threads    server_mt (round trips/s)    server_per_core (round trips/s)" << std::endl;
+  int port = 15600;
+  for(std::size_t threads : thread_counts)
+  {
+    double shared = round_trips_per_second<neev::server_mt<server_observer>>(threads, std::to_string(port++));
+    double per_core = round_trips_per_second<neev::server_per_core<server_observer>>(threads, std::to_string(port++));
+    std::cout << std::setw(7) << threads
+              << std::setw(29) << static_cast<std::size_t>(shared)
+              << std::setw(35) << static_cast<std::size_t>(per_core) << std::endl;
+  }
+  return 0;
+}
@@ -3,6 +3,10 @@
 // 
 // (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
 
+#ifndef POSITION_HPP
+#define POSITION_HPP
+
+#include <neev/buffer/pod_buffer.hpp>
 #include <cstdint>
 
 struct position
@@ -21,3 +25,13 @@ struct position
     ar & x & y & z;
   }
 };
+
+// Layout used to send a position with pod_buffer.
+namespace neev{
+template <>
+struct pod_layout<position>
+: pod_fields<NEEV_POD_FIELD(position, x), NEEV_POD_FIELD(position, y), NEEV_POD_FIELD(position, z)>
+{};
+} // namespace neev
+
+#endif // POSITION_HPP
@@ -7,53 +7,164 @@
 #define NEEV_BUFFER_ARCHIVE_BUFFER_HPP
 
 #include <neev/buffer/prefixed_buffer.hpp>
+#include <neev/error.hpp>
+#include <boost/archive/archive_exception.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/system/system_error.hpp>
+#include <array>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
 
 namespace neev{
+namespace detail{
 
-template <class Archive, class PrefixType>
+  /** Stream buffer appending the characters written to a string.
+  */
+  class string_append_streambuf
+  : public std::streambuf
+  {
+  public:
+    explicit string_append_streambuf(std::string& output)
+    : output_(output)
+    {}
+
+  protected:
+    int_type overflow(int_type c)
+    {
+      if(!traits_type::eq_int_type(c, traits_type::eof()))
+      {
+        output_.push_back(traits_type::to_char_type(c));
+      }
+      return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char_type* s, std::streamsize n)
+    {
+      output_.append(s, static_cast<std::size_t>(n));
+      return n;
+    }
+
+  private:
+    std::string& output_;
+  };
+
+  /** Stream buffer reading an array of characters in place.
+  */
+  class array_streambuf
+  : public std::streambuf
+  {
+  public:
+    array_streambuf(const char* data, std::size_t size)
+    {
+      char* first = const_cast<char*>(data);
+      setg(first, first, first + size);
+    }
+  };
+} // namespace detail
+
+/** Archive policy of the archive buffers using the text archives of Boost.Serialization.
+* It is portable across architectures.
+*/
+struct text_archive
+{
+  template <class Data>
+  static void save(std::streambuf& buffer, const Data& data)
+  {
+    std::ostream stream(&buffer);
+    boost::archive::text_oarchive archive(stream);
+    archive << data;
+  }
+
+  template <class Data>
+  static void load(std::streambuf& buffer, Data& data)
+  {
+    std::istream stream(&buffer);
+    boost::archive::text_iarchive archive(stream);
+    archive >> data;
+  }
+};
+
+/** Archive policy of the archive buffers using the binary archives of Boost.Serialization.
+* The archives work directly on the stream buffer, without header and
+* without locale conversion. Both peers must share the same architecture.
+*/
+struct binary_archive
+{
+  static constexpr unsigned int flags =
+    boost::archive::no_header | boost::archive::no_codecvt;
+
+  template <class Data>
+  static void save(std::streambuf& buffer, const Data& data)
+  {
+    boost::archive::binary_oarchive archive(buffer, flags);
+    archive << data;
+  }
+
+  template <class Data>
+  static void load(std::streambuf& buffer, Data& data)
+  {
+    boost::archive::binary_iarchive archive(buffer, flags);
+    archive >> data;
+  }
+};
+
+template <class Data, class PrefixType, class Archive = text_archive>
 class archive_send_buffer;
 
-template <class Archive, class PrefixType>
+template <class Data, class PrefixType, class Archive = text_archive>
 class archive_receive_buffer;
 
-template <class Archive, class PrefixType, class TransferCategory>
+template <class Data, class PrefixType, class TransferCategory, class Archive = text_archive>
 struct archive_buffer;
 
-template <class Archive, class PrefixType>
-struct archive_buffer<Archive, PrefixType, send_op>
+template <class Data, class PrefixType, class Archive>
+struct archive_buffer<Data, PrefixType, send_op, Archive>
 {
-  using type = archive_send_buffer<Archive, PrefixType>;
+  using type = archive_send_buffer<Data, PrefixType, Archive>;
 };
 
-template <class PrefixType>
-struct archive_buffer<Archive, PrefixType, receive_op>
+template <class Data, class PrefixType, class Archive>
+struct archive_buffer<Data, PrefixType, receive_op, Archive>
 {
-  using type = archive_receive_buffer<Archive, PrefixType>;
+  using type = archive_receive_buffer<Data, PrefixType, Archive>;
 };
 
-template <class Archive, class TransferCategory>
-using archive8_buffer = prefixed_buffer<Archive, std::uint8_t, TransferCategory>;
+template <class Data, class TransferCategory, class Archive = text_archive>
+using archive8_buffer = archive_buffer<Data, std::uint8_t, TransferCategory, Archive>;
 
-template <class Archive, class TransferCategory>
-using archive16_buffer = prefixed_buffer<Archive, std::uint16_t, TransferCategory>;
+template <class Data, class TransferCategory, class Archive = text_archive>
+using archive16_buffer = archive_buffer<Data, std::uint16_t, TransferCategory, Archive>;
 
-template <class Archive, class TransferCategory>
-using archive32_buffer = prefixed_buffer<Archive, std::uint32_t, TransferCategory>;
+template <class Data, class TransferCategory, class Archive = text_archive>
+using archive32_buffer = archive_buffer<Data, std::uint32_t, TransferCategory, Archive>;
 
-template <class Archive, class PrefixType>
+/** Receive the messages sent by an archive_send_buffer and deserialize them
+* with the Archive policy, directly from the received bytes.
+* A message that can't be deserialized fails the transfer with
+* error::invalid_archive.
+*/
+template <class Data, class PrefixType, class Archive>
 class archive_receive_buffer
 : private prefixed_receive_buffer<PrefixType>
 {
   using prefixed_buffer_type = prefixed_receive_buffer<PrefixType>;
 public:
-  using data_type = Archive;
+  using data_type = Data;
   using prefix_type = PrefixType;
+  using archive_type = Archive;
   using buffer_type = typename prefixed_buffer_type::buffer_type;
   using transfer_category = receive_op;
 
-  using prefixed_buffer_type::prefixed_buffer_type;
+  archive_receive_buffer()
+  : decoded_(false)
+  {}
+
   using prefixed_buffer_type::has_next_chunk;
   using prefixed_buffer_type::next_chunk;
   using prefixed_buffer_type::chunk;
@@ -61,46 +172,131 @@ public:
   using prefixed_buffer_type::size;
   using prefixed_buffer_type::chunk_size;
 
-  data_type data()
+  void reset()
+  {
+    prefixed_buffer_type::reset();
+    decoded_ = false;
+  }
+
+  /** Deserialize the message the first time it is called.
+  * @throw boost::system::system_error if the message is not a valid archive
+  * (error::invalid_archive), or asks for a container too large to hold
+  * (error::message_too_large).
+  */
+  data_type& data()
   {
-    data_type unarchived_data;
-    std::istringstream archive_stream(prefixed_buffer_type::data());
-    boost::archive::text_iarchive archive(archive_stream);
-    archive >> unarchived_data;
-    return unarchived_data;
+    if(!decoded_)
+    {
+      const std::string& bytes = prefixed_buffer_type::data();
+      detail::array_streambuf buffer(bytes.data(), bytes.size());
+      try
+      {
+        archive_type::load(buffer, data_);
+      }
+      catch(const boost::archive::archive_exception&)
+      {
+        throw boost::system::system_error(error::make_error_code(error::invalid_archive));
+      }
+      // A corrupted size can ask for a container larger than it can hold, or
+      // than the memory available.
+      catch(const std::length_error&)
+      {
+        throw boost::system::system_error(error::make_error_code(error::message_too_large));
+      }
+      catch(const std::exception&)
+      {
+        throw boost::system::system_error(error::make_error_code(error::invalid_archive));
+      }
+      decoded_ = true;
+    }
+    return data_;
   }
+
+private:
+  data_type data_;
+  bool decoded_;
 };
 
-template <class Archive, class PrefixType>
+/** Serialize data with the Archive policy directly in the storage sent on
+* the socket, the prefix is sent with it in the same gathered write.
+* The data of the transfer is the serialized payload.
+*/
+template <class Data, class PrefixType, class Archive>
 class archive_send_buffer
-: private prefixed_send_buffer<PrefixType>
 {
-  using prefixed_buffer_type = prefixed_send_buffer<PrefixType>;
 public:
-  using data_type = Archive;
+  using data_type = std::string;
   using prefix_type = PrefixType;
-  using buffer_type = typename prefixed_buffer_type::buffer_type;
+  using archive_type = Archive;
+  using buffer_type = std::array<boost::asio::const_buffers_1, 2>;
   using transfer_category = send_op;
 
-  archive_send_buffer(const data_type& data)
-  : prefixed_buffer_type(make_archive(data))
-  {}
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
 
-  static prefixed_buffer_type::data_type make_data(const data_type& data)
+  archive_send_buffer(const Data& data)
+  : payload_(serialize(data))
+  , prefix_(hton(static_cast<prefix_type>(payload_.size())))
   {
-    std::ostringstream archive_stream;
-    boost::archive::text_oarchive archive(archive_stream);
-    archive << data;
-    return archive_stream.str();
+    BOOST_ASSERT_MSG(std::numeric_limits<prefix_type>::max() >= payload_.size(),
+      "archive_send_buffer: Try to send data which size is too large "
+      "(choose a larger prefix type).");
   }
 
-  using prefixed_buffer_type::has_next_chunk;
-  using prefixed_buffer_type::next_chunk;
-  using prefixed_buffer_type::chunk;
-  using prefixed_buffer_type::is_chunk_complete;
-  using prefixed_buffer_type::size;
-  using prefixed_buffer_type::chunk_size;
-  using prefixed_buffer_type::data;
+  archive_send_buffer(archive_send_buffer&&) = delete;
+  archive_send_buffer& operator=(archive_send_buffer&&) = delete;
+
+  archive_send_buffer(const archive_send_buffer&) = delete;
+  archive_send_buffer& operator=(const archive_send_buffer&) = delete;
+
+  static data_type serialize(const Data& data)
+  {
+    data_type payload;
+    detail::string_append_streambuf buffer(payload);
+    archive_type::save(buffer, data);
+    return payload;
+  }
+
+  boost::optional<std::size_t> size() const
+  {
+    return sizeof(prefix_type) + payload_.size();
+  }
+
+  std::size_t chunk_size() const
+  {
+    return *size();
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return false;
+  }
+
+  void next_chunk() const
+  {
+    BOOST_ASSERT_MSG(false,
+      "archive_send_buffer::next_chunk: Should not be called "
+      "(only 1 chunk in this buffer).");
+  }
+
+  buffer_type chunk() const
+  {
+    return buffer_type{
+      boost::asio::buffer(reinterpret_cast<const char*>(&prefix_), sizeof(prefix_)),
+      boost::asio::buffer(payload_)
+    };
+  }
+
+  const data_type& data() const { return payload_; }
+
+private:
+  data_type payload_;
+  prefix_type prefix_;
 };
 
 } // namespace neev
@@ -97,6 +97,7 @@ class basic_receive_buffer
 
   explicit basic_receive_buffer(std::size_t n)
   : data_(n, 0)
+  , expected_size_(n)
   {}
 
   basic_receive_buffer(basic_receive_buffer&&) = delete;
@@ -137,10 +138,17 @@ class basic_receive_buffer
       "(only 1 chunk in this buffer).");
   }
 
+  // Prepare the buffer for the next message, the storage is reused.
+  void reset()
+  {
+    data_.resize(expected_size_);
+  }
+
   data_type& data() { return data_; }
 
  private:
   data_type data_;
+  std::size_t expected_size_;
 };
 
 } // namespace neev
@@ -0,0 +1,204 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#ifndef NEEV_BUFFER_BUDGETED_BUFFER_HPP
+#define NEEV_BUFFER_BUDGETED_BUFFER_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/transfer_operation.hpp>
+#include <neev/network_converter.hpp>
+#include <neev/memory_budget.hpp>
+#include <neev/slab_pool.hpp>
+#include <neev/error.hpp>
+#include <boost/system/system_error.hpp>
+#include <cstdint>
+#include <memory>
+
+namespace neev{
+
+/** Bytes of a received message together with the memory they are charged for.
+* The memory goes back to the budget when they are destroyed.
+*/
+class budgeted_bytes
+: public pooled_bytes
+{
+ public:
+  budgeted_bytes() = default;
+
+  budgeted_bytes(std::size_t size, memory_reservation&& reservation)
+  : pooled_bytes(size)
+  , reservation_(std::move(reservation))
+  {}
+
+  budgeted_bytes(budgeted_bytes&&) = default;
+  budgeted_bytes& operator=(budgeted_bytes&&) = default;
+
+  const memory_reservation& reservation() const { return reservation_; }
+
+ private:
+  memory_reservation reservation_;
+};
+
+template <class PrefixType>
+class budgeted_prefixed_receive_buffer;
+
+template <class PrefixType, class TransferCategory>
+struct budgeted_prefixed_buffer;
+
+template <class PrefixType>
+struct budgeted_prefixed_buffer<PrefixType, receive_op>
+{
+  using type = budgeted_prefixed_receive_buffer<PrefixType>;
+};
+
+template <class TransferCategory>
+using budgeted_prefixed8_buffer = budgeted_prefixed_buffer<std::uint8_t, TransferCategory>;
+
+template <class TransferCategory>
+using budgeted_prefixed16_buffer = budgeted_prefixed_buffer<std::uint16_t, TransferCategory>;
+
+template <class TransferCategory>
+using budgeted_prefixed32_buffer = budgeted_prefixed_buffer<std::uint32_t, TransferCategory>;
+
+/** Receive the messages sent by a prefixed_send_buffer within a memory budget.
+*
+* Once the prefix is received, the message size is reserved in the memory
+* account of the connection before the payload storage is allocated:
+* - a size above budget().max_message_size() fails the transfer with
+*   error::message_too_large,
+* - otherwise, if the budget is exhausted, the transfer is paused
+*   (transfer_paused) until enough memory is released (transfer_resumed).
+*
+* The data is a budgeted_bytes, the memory is released when the observer
+* destroys it, or when the next message is received if it keeps it in place.
+* A transfer cancelled or timed out while paused leaves the waiting queue
+* and doesn't keep any memory.
+*/
+template <class PrefixType>
+class budgeted_prefixed_receive_buffer
+{
+ public:
+  using data_type = budgeted_bytes;
+  using prefix_type = PrefixType;
+  using buffer_type = boost::asio::mutable_buffers_1;
+  using transfer_category = receive_op;
+
+ private:
+  enum status
+  {
+    PREFIX_CHUNK,
+    DATA_CHUNK
+  };
+
+ public:
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  explicit budgeted_prefixed_receive_buffer(const std::shared_ptr<memory_account>& account)
+  : account_(account)
+  , status_(PREFIX_CHUNK)
+  , prefix_(0)
+  {
+    BOOST_ASSERT_MSG(static_cast<bool>(account),
+      "Cannot construct a budgeted_prefixed_receive_buffer object with an uninitialized account.");
+  }
+
+  budgeted_prefixed_receive_buffer(budgeted_prefixed_receive_buffer&&) = delete;
+  budgeted_prefixed_receive_buffer& operator=(budgeted_prefixed_receive_buffer&&) = delete;
+
+  budgeted_prefixed_receive_buffer(const budgeted_prefixed_receive_buffer&) = delete;
+  budgeted_prefixed_receive_buffer& operator=(const budgeted_prefixed_receive_buffer&) = delete;
+
+  // If the full-size is not known, return nullopt.
+  boost::optional<std::size_t> size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::optional<std::size_t>();
+    else
+      return sizeof(prefix_type) + data_.size();
+  }
+
+  std::size_t chunk_size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return sizeof(prefix_type);
+    else
+      return data_.size();
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return status_ != DATA_CHUNK;
+  }
+
+  buffer_type chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::asio::buffer(reinterpret_cast<char*>(&prefix_), sizeof(prefix_type));
+    else
+      return boost::asio::buffer(data_.data(), data_.size());
+  }
+
+  // Throw boost::system::system_error if the message is too large.
+  bool wait_next_chunk(std::function<void()> resume)
+  {
+    std::size_t size = ntoh(prefix_);
+    if(size > account_->budget().max_message_size())
+    {
+      throw boost::system::system_error(error::make_error_code(error::message_too_large));
+    }
+    // The previous message, if still here, must not be charged twice.
+    data_ = data_type();
+    return account_->acquire(size, std::move(resume));
+  }
+
+  // The transfer is stopped while waiting for the memory of the message.
+  bool cancel_wait()
+  {
+    return account_->withdraw();
+  }
+
+  // The transfer is stopped after the memory of the message was acquired
+  // but before next_chunk() takes it.
+  void abandon()
+  {
+    account_->release(ntoh(prefix_));
+  }
+
+  // Pre: The memory of the message has been acquired (see wait_next_chunk).
+  // Post: No effect if there is no next chunk.
+  void next_chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+    {
+      std::size_t size = ntoh(prefix_);
+      data_ = data_type(size, memory_reservation(account_, size));
+      status_ = DATA_CHUNK;
+    }
+  }
+
+  void reset()
+  {
+    status_ = PREFIX_CHUNK;
+    prefix_ = 0;
+  }
+
+  data_type& data() { return data_; }
+
+ private:
+  std::shared_ptr<memory_account> account_;
+  status status_;
+  prefix_type prefix_;
+  data_type data_;
+};
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_BUDGETED_BUFFER_HPP
@@ -0,0 +1,277 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Prefixed messages followed by the CRC32C of their payload
+* (4 bytes, network byte order).
+*/
+
+#ifndef NEEV_BUFFER_CHECKED_BUFFER_HPP
+#define NEEV_BUFFER_CHECKED_BUFFER_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/transfer_operation.hpp>
+#include <neev/network_converter.hpp>
+#include <neev/crc32c.hpp>
+#include <neev/error.hpp>
+#include <boost/assert.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace neev{
+
+template <class PrefixType>
+class checked_prefixed_send_buffer;
+
+template <class PrefixType>
+class checked_prefixed_receive_buffer;
+
+template <class PrefixType, class TransferCategory>
+struct checked_prefixed_buffer;
+
+template <class PrefixType>
+struct checked_prefixed_buffer<PrefixType, send_op>
+{
+  using type = checked_prefixed_send_buffer<PrefixType>;
+};
+
+template <class PrefixType>
+struct checked_prefixed_buffer<PrefixType, receive_op>
+{
+  using type = checked_prefixed_receive_buffer<PrefixType>;
+};
+
+template <class TransferCategory>
+using checked_prefixed8_buffer = checked_prefixed_buffer<std::uint8_t, TransferCategory>;
+
+template <class TransferCategory>
+using checked_prefixed16_buffer = checked_prefixed_buffer<std::uint16_t, TransferCategory>;
+
+template <class TransferCategory>
+using checked_prefixed32_buffer = checked_prefixed_buffer<std::uint32_t, TransferCategory>;
+
+/** Send a message prefixed by its size and followed by its CRC32C.
+*/
+template <class PrefixType>
+class checked_prefixed_send_buffer
+{
+ public:
+  using data_type = std::string;
+  using prefix_type = PrefixType;
+  using buffer_type = std::array<boost::asio::const_buffers_1, 3>;
+  using transfer_category = send_op;
+
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  checked_prefixed_send_buffer(data_type&& data)
+  : data_(std::move(data))
+  , prefix_(hton(static_cast<prefix_type>(data_.size())))
+  , checksum_(hton(crc32c(0, data_.data(), data_.size())))
+  {
+    BOOST_ASSERT_MSG(std::numeric_limits<prefix_type>::max() >= data_.size(),
+      "checked_prefixed_send_buffer: Try to send data which size is too large "
+      "(choose a larger prefix type).");
+  }
+
+  checked_prefixed_send_buffer(checked_prefixed_send_buffer&&) = delete;
+  checked_prefixed_send_buffer& operator=(checked_prefixed_send_buffer&&) = delete;
+
+  checked_prefixed_send_buffer(const checked_prefixed_send_buffer&) = delete;
+  checked_prefixed_send_buffer& operator=(const checked_prefixed_send_buffer&) = delete;
+
+  boost::optional<std::size_t> size() const
+  {
+    return sizeof(prefix_) + data_.size() + sizeof(checksum_);
+  }
+
+  std::size_t chunk_size() const
+  {
+    return *size();
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return false;
+  }
+
+  void next_chunk() const
+  {
+    BOOST_ASSERT_MSG(false,
+      "checked_prefixed_send_buffer::next_chunk: Should not be called "
+      "(only 1 chunk in this buffer).");
+  }
+
+  buffer_type chunk() const
+  {
+    return buffer_type{
+      boost::asio::buffer(reinterpret_cast<const char*>(&prefix_), sizeof(prefix_)),
+      boost::asio::buffer(data_),
+      boost::asio::buffer(reinterpret_cast<const char*>(&checksum_), sizeof(checksum_))
+    };
+  }
+
+  const data_type& data() const { return data_; }
+
+ private:
+  data_type data_;
+  prefix_type prefix_;
+  std::uint32_t checksum_;
+};
+
+/** Receive the messages sent by a checked_prefixed_send_buffer.
+* The payload is received by chunks of at most max_chunk_size bytes, the
+* checksum is extended with each chunk once it is received, while it is still
+* in the cache, then the checksum of the sender is received in a last chunk.
+* A mismatch fails the transfer with error::checksum_mismatch.
+*/
+template <class PrefixType>
+class checked_prefixed_receive_buffer
+{
+ public:
+  using data_type = std::string;
+  using prefix_type = PrefixType;
+  using buffer_type = boost::asio::mutable_buffers_1;
+  using transfer_category = receive_op;
+
+ private:
+  enum status
+  {
+    PREFIX_CHUNK,
+    DATA_CHUNK,
+    CHECKSUM_CHUNK
+  };
+
+ public:
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  static constexpr std::size_t default_chunk_size = 64 * 1024;
+
+  explicit checked_prefixed_receive_buffer(std::size_t max_chunk_size = default_chunk_size)
+  : max_chunk_size_(max_chunk_size)
+  , status_(PREFIX_CHUNK)
+  , prefix_(0)
+  , offset_(0)
+  , checksum_(0)
+  , expected_(0)
+  {
+    BOOST_ASSERT_MSG(max_chunk_size_ != 0,
+      "checked_prefixed_receive_buffer: The chunk size can't be 0.");
+  }
+
+  checked_prefixed_receive_buffer(checked_prefixed_receive_buffer&&) = delete;
+  checked_prefixed_receive_buffer& operator=(checked_prefixed_receive_buffer&&) = delete;
+
+  checked_prefixed_receive_buffer(const checked_prefixed_receive_buffer&) = delete;
+  checked_prefixed_receive_buffer& operator=(const checked_prefixed_receive_buffer&) = delete;
+
+  // If the full-size is not known, return nullopt.
+  boost::optional<std::size_t> size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::optional<std::size_t>();
+    else
+      return sizeof(prefix_type) + data_.size() + sizeof(expected_);
+  }
+
+  std::size_t chunk_size() const
+  {
+    switch(status_)
+    {
+      case PREFIX_CHUNK: return sizeof(prefix_type);
+      case DATA_CHUNK: return std::min(max_chunk_size_, data_.size() - offset_);
+      default: return sizeof(expected_);
+    }
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return status_ != CHECKSUM_CHUNK;
+  }
+
+  buffer_type chunk()
+  {
+    switch(status_)
+    {
+      case PREFIX_CHUNK:
+        return boost::asio::buffer(reinterpret_cast<char*>(&prefix_), sizeof(prefix_type));
+      case DATA_CHUNK:
+        return boost::asio::buffer(&data_[offset_], chunk_size());
+      default:
+        return boost::asio::buffer(reinterpret_cast<char*>(&expected_), sizeof(expected_));
+    }
+  }
+
+  // Post: No effect if there is no next chunk.
+  void next_chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+    {
+      data_.resize(ntoh(prefix_));
+      status_ = DATA_CHUNK;
+    }
+    else if(status_ == DATA_CHUNK)
+    {
+      std::size_t received = chunk_size();
+      checksum_ = crc32c(checksum_, &data_[offset_], received);
+      offset_ += received;
+    }
+    if(status_ == DATA_CHUNK && offset_ == data_.size())
+    {
+      status_ = CHECKSUM_CHUNK;
+    }
+  }
+
+  /** Compare the checksum received with the one computed over the payload.
+  */
+  boost::system::error_code verify() const
+  {
+    if(ntoh(expected_) != checksum_)
+    {
+      return error::make_error_code(error::checksum_mismatch);
+    }
+    return boost::system::error_code();
+  }
+
+  // Prepare the buffer for the next message, the data storage is reused.
+  void reset()
+  {
+    status_ = PREFIX_CHUNK;
+    prefix_ = 0;
+    offset_ = 0;
+    checksum_ = 0;
+  }
+
+  data_type& data() { return data_; }
+
+ private:
+  std::size_t max_chunk_size_;
+  status status_;
+  prefix_type prefix_;
+  std::size_t offset_;
+  std::uint32_t checksum_;
+  std::uint32_t expected_;
+  data_type data_;
+};
+
+template <class PrefixType>
+constexpr std::size_t checked_prefixed_receive_buffer<PrefixType>::default_chunk_size;
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_CHECKED_BUFFER_HPP
@@ -0,0 +1,373 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Prefixed messages compressed with zlib when they are large enough.
+*
+* The prefix is followed by a flag byte telling if the payload is compressed.
+* A compressed payload starts with its original size (8 bytes, network byte order).
+* Link with -lz.
+*/
+
+#ifndef NEEV_BUFFER_COMPRESSED_BUFFER_HPP
+#define NEEV_BUFFER_COMPRESSED_BUFFER_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/transfer_operation.hpp>
+#include <neev/network_converter.hpp>
+#include <neev/slab_pool.hpp>
+#include <neev/error.hpp>
+#include <boost/asio.hpp>
+#include <boost/assert.hpp>
+#include <boost/system/system_error.hpp>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <zlib.h>
+
+namespace neev{
+namespace detail{
+
+  enum compression_flag : unsigned char
+  {
+    uncompressed_payload = 0,
+    zlib_payload = 1
+  };
+
+  constexpr std::size_t original_size_bytes = sizeof(std::uint64_t);
+} // namespace detail
+
+template <class PrefixType>
+class compressed_send_buffer;
+
+template <class PrefixType>
+class compressed_receive_buffer;
+
+template <class PrefixType, class TransferCategory>
+struct compressed_buffer;
+
+template <class PrefixType>
+struct compressed_buffer<PrefixType, send_op>
+{
+  using type = compressed_send_buffer<PrefixType>;
+};
+
+template <class PrefixType>
+struct compressed_buffer<PrefixType, receive_op>
+{
+  using type = compressed_receive_buffer<PrefixType>;
+};
+
+template <class TransferCategory>
+using compressed16_buffer = compressed_buffer<std::uint16_t, TransferCategory>;
+
+template <class TransferCategory>
+using compressed32_buffer = compressed_buffer<std::uint32_t, TransferCategory>;
+
+/** Send a message compressed with the given zlib level (0 to 9) if its size is
+* at least threshold bytes. The message is sent uncompressed when the
+* compression doesn't make it smaller, it is then gathered with the header
+* and never copied.
+*/
+template <class PrefixType>
+class compressed_send_buffer
+{
+ public:
+  using data_type = std::string;
+  using prefix_type = PrefixType;
+  using buffer_type = std::array<boost::asio::const_buffers_1, 2>;
+  using transfer_category = send_op;
+
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  static constexpr std::size_t default_threshold = 256;
+
+  compressed_send_buffer(data_type&& data,
+    int level = Z_DEFAULT_COMPRESSION,
+    std::size_t threshold = default_threshold)
+  : data_(std::move(data))
+  , header_size_(sizeof(prefix_type) + 1)
+  {
+    if(level == 0 || data_.size() < threshold || !compress(level))
+    {
+      header_[sizeof(prefix_type)] = static_cast<char>(detail::uncompressed_payload);
+    }
+    write_prefix();
+  }
+
+  compressed_send_buffer(compressed_send_buffer&&) = delete;
+  compressed_send_buffer& operator=(compressed_send_buffer&&) = delete;
+
+  compressed_send_buffer(const compressed_send_buffer&) = delete;
+  compressed_send_buffer& operator=(const compressed_send_buffer&) = delete;
+
+  /** @return true if the payload is sent compressed.
+  */
+  bool is_compressed() const
+  {
+    return header_[sizeof(prefix_type)] == static_cast<char>(detail::zlib_payload);
+  }
+
+  boost::optional<std::size_t> size() const
+  {
+    return header_size_ + payload().size();
+  }
+
+  std::size_t chunk_size() const
+  {
+    return *size();
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return false;
+  }
+
+  void next_chunk() const
+  {
+    BOOST_ASSERT_MSG(false,
+      "compressed_send_buffer::next_chunk: Should not be called "
+      "(only 1 chunk in this buffer).");
+  }
+
+  buffer_type chunk() const
+  {
+    return buffer_type{
+      boost::asio::buffer(header_.data(), header_size_),
+      boost::asio::buffer(payload())
+    };
+  }
+
+  const data_type& data() const { return data_; }
+
+ private:
+  const std::string& payload() const
+  {
+    return is_compressed() ? compressed_ : data_;
+  }
+
+  // @return false if the compressed payload is not smaller.
+  bool compress(int level)
+  {
+    uLongf compressed_size = ::compressBound(static_cast<uLong>(data_.size()));
+    compressed_.resize(compressed_size);
+    int result = ::compress2(reinterpret_cast<Bytef*>(&compressed_[0]), &compressed_size,
+      reinterpret_cast<const Bytef*>(data_.data()), static_cast<uLong>(data_.size()), level);
+    if(result != Z_OK || detail::original_size_bytes + compressed_size >= data_.size())
+    {
+      compressed_.clear();
+      return false;
+    }
+    compressed_.resize(compressed_size);
+    header_[sizeof(prefix_type)] = static_cast<char>(detail::zlib_payload);
+    std::uint64_t original_size = hton(static_cast<std::uint64_t>(data_.size()));
+    std::memcpy(&header_[sizeof(prefix_type) + 1], &original_size, detail::original_size_bytes);
+    header_size_ += detail::original_size_bytes;
+    return true;
+  }
+
+  void write_prefix()
+  {
+    std::size_t size = *this->size() - sizeof(prefix_type);
+    BOOST_ASSERT_MSG(std::numeric_limits<prefix_type>::max() >= size,
+      "compressed_send_buffer: Try to send data which size is too large "
+      "(choose a larger prefix type).");
+    prefix_type prefix = hton(static_cast<prefix_type>(size));
+    std::memcpy(&header_[0], &prefix, sizeof(prefix_type));
+  }
+
+  data_type data_;
+  std::string compressed_;
+  // The prefix, the flag and, if compressed, the original size.
+  std::array<char, sizeof(prefix_type) + 1 + detail::original_size_bytes> header_;
+  std::size_t header_size_;
+};
+
+template <class PrefixType>
+constexpr std::size_t compressed_send_buffer<PrefixType>::default_threshold;
+
+/** Receive the messages sent by a compressed_send_buffer.
+* The flag byte and the payload are received in a single read, the payload
+* straight into pooled_bytes (see slab_pool.hpp). An uncompressed payload is
+* the data itself, a compressed one is decompressed the first time data() is
+* called. A corrupted payload fails the transfer with error::corrupted_payload,
+* and a payload decompressing to more than max_size bytes with
+* error::message_too_large.
+*/
+template <class PrefixType>
+class compressed_receive_buffer
+{
+ public:
+  using data_type = pooled_bytes;
+  using prefix_type = PrefixType;
+  using buffer_type = std::array<boost::asio::mutable_buffers_1, 2>;
+  using transfer_category = receive_op;
+
+ private:
+  enum status
+  {
+    PREFIX_CHUNK,
+    DATA_CHUNK
+  };
+
+ public:
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  explicit compressed_receive_buffer(
+    std::size_t max_size = std::numeric_limits<std::size_t>::max())
+  : max_size_(max_size)
+  , status_(PREFIX_CHUNK)
+  , prefix_(0)
+  , flag_(0)
+  , decoded_(false)
+  {}
+
+  compressed_receive_buffer(compressed_receive_buffer&&) = delete;
+  compressed_receive_buffer& operator=(compressed_receive_buffer&&) = delete;
+
+  compressed_receive_buffer(const compressed_receive_buffer&) = delete;
+  compressed_receive_buffer& operator=(const compressed_receive_buffer&) = delete;
+
+  // If the full-size is not known, return nullopt.
+  boost::optional<std::size_t> size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::optional<std::size_t>();
+    else
+      return sizeof(prefix_type) + chunk_size();
+  }
+
+  std::size_t chunk_size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return sizeof(prefix_type);
+    else
+      return 1 + payload_.size();
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return status_ == PREFIX_CHUNK;
+  }
+
+  buffer_type chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+    {
+      return buffer_type{
+        boost::asio::buffer(reinterpret_cast<char*>(&prefix_), sizeof(prefix_type)),
+        boost::asio::mutable_buffers_1(nullptr, 0)
+      };
+    }
+    else
+    {
+      return buffer_type{
+        boost::asio::buffer(&flag_, 1),
+        boost::asio::buffer(payload_.data(), payload_.size())
+      };
+    }
+  }
+
+  // Post: No effect if there is no next chunk.
+  // Throw boost::system::system_error if the frame has no flag byte.
+  void next_chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+    {
+      std::size_t size = ntoh(prefix_);
+      if(size == 0)
+      {
+        fail(error::corrupted_payload);
+      }
+      payload_.resize(size - 1);
+      status_ = DATA_CHUNK;
+    }
+  }
+
+  // Prepare the buffer for the next message, the payload block is reused.
+  void reset()
+  {
+    status_ = PREFIX_CHUNK;
+    prefix_ = 0;
+    decoded_ = false;
+  }
+
+  // Throw boost::system::system_error if the payload can't be decompressed.
+  data_type& data()
+  {
+    if(flag_ == detail::uncompressed_payload)
+    {
+      return payload_;
+    }
+    if(!decoded_)
+    {
+      decode();
+      decoded_ = true;
+    }
+    return data_;
+  }
+
+private:
+  static void fail(error::transfer_errors e)
+  {
+    throw boost::system::system_error(error::make_error_code(e));
+  }
+
+  void decode()
+  {
+    if(flag_ != detail::zlib_payload || payload_.size() < detail::original_size_bytes)
+    {
+      fail(error::corrupted_payload);
+    }
+    std::uint64_t original_size;
+    std::memcpy(&original_size, payload_.data(), detail::original_size_bytes);
+    original_size = ntoh(original_size);
+    // Deflate can't compress more than 1032:1, a larger size is a lie.
+    std::size_t compressed_size = payload_.size() - detail::original_size_bytes;
+    if(original_size / 1032 > compressed_size)
+    {
+      fail(error::corrupted_payload);
+    }
+    if(original_size > max_size_ || original_size > std::numeric_limits<uLong>::max())
+    {
+      fail(error::message_too_large);
+    }
+    data_.resize(static_cast<std::size_t>(original_size));
+    uLongf size = static_cast<uLongf>(original_size);
+    int result = ::uncompress(reinterpret_cast<Bytef*>(data_.data()), &size,
+      reinterpret_cast<const Bytef*>(payload_.data() + detail::original_size_bytes),
+      static_cast<uLong>(compressed_size));
+    if(result != Z_OK || size != original_size)
+    {
+      fail(error::corrupted_payload);
+    }
+  }
+
+  std::size_t max_size_;
+  status status_;
+  prefix_type prefix_;
+  unsigned char flag_;
+  // The payload as received, it is the data when it is not compressed.
+  pooled_bytes payload_;
+  data_type data_;
+  bool decoded_;
+};
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_COMPRESSED_BUFFER_HPP
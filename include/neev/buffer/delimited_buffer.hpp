@@ -0,0 +1,242 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#ifndef NEEV_BUFFER_DELIMITED_BUFFER_HPP
+#define NEEV_BUFFER_DELIMITED_BUFFER_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/transfer_operation.hpp>
+#include <neev/error.hpp>
+#include <boost/assert.hpp>
+#include <boost/system/system_error.hpp>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+
+namespace neev{
+
+class delimited_receive_buffer;
+
+template <class TransferCategory>
+struct delimited_buffer;
+
+template <>
+struct delimited_buffer<receive_op>
+{
+  using type = delimited_receive_buffer;
+};
+
+/** Receive messages terminated by a delimiter of one or several bytes,
+* such as the lines of a text protocol.
+*
+* The bytes are read by large reads (read_size bytes) and the delimiter is
+* searched in each read with memchr, by is_chunk_complete(): the read stops
+* as soon as the delimiter is received. The data is the message without its
+* delimiter. The bytes received after the delimiter are kept for the next
+* message (see reset()), the next message may even be complete without
+* reading from the socket.
+* Outside of async_receive_loop(), they are taken with take_leftover() and
+* given to the buffer of the next transfer (the received parameter).
+*
+* A message longer than max_length bytes fails the transfer with
+* error::message_too_large.
+*/
+class delimited_receive_buffer
+{
+ public:
+  using data_type = std::string;
+  using buffer_type = boost::asio::mutable_buffers_1;
+  using transfer_category = receive_op;
+
+  static constexpr std::size_t default_max_length = 64 * 1024;
+  static constexpr std::size_t default_read_size = 4096;
+
+  /**
+  * \param received are the bytes already received for the next messages.
+  */
+  explicit delimited_receive_buffer(const std::string& delimiter,
+    std::size_t max_length = default_max_length,
+    std::size_t read_size = default_read_size,
+    std::string received = std::string())
+  : delimiter_(delimiter)
+  , max_length_(max_length)
+  , read_size_(read_size)
+  , buffer_(std::min(read_size_, max_storage()), 0)
+  , chunk_start_(0)
+  , filled_(0)
+  , search_from_(0)
+  , found_(false)
+  {
+    BOOST_ASSERT_MSG(!delimiter_.empty(),
+      "delimited_receive_buffer: The delimiter can't be empty.");
+    BOOST_ASSERT_MSG(read_size_ != 0,
+      "delimited_receive_buffer: The read size can't be 0.");
+    if(!received.empty())
+    {
+      leftover_ = std::move(received);
+      reset();
+    }
+  }
+
+  delimited_receive_buffer(delimited_receive_buffer&&) = delete;
+  delimited_receive_buffer& operator=(delimited_receive_buffer&&) = delete;
+
+  delimited_receive_buffer(const delimited_receive_buffer&) = delete;
+  delimited_receive_buffer& operator=(const delimited_receive_buffer&) = delete;
+
+  // The size is only known once the delimiter is found.
+  boost::optional<std::size_t> size() const
+  {
+    if(found_)
+      return buffer_.size() + delimiter_.size();
+    else
+      return boost::optional<std::size_t>();
+  }
+
+  std::size_t chunk_size() const
+  {
+    return buffer_.size() - chunk_start_;
+  }
+
+  // Search the delimiter in the bytes received since the last call.
+  // Unlike most buffers, it has side effects: the search resumes where the
+  // previous call stopped, and the message is split once the delimiter is
+  // found. They are idempotent, a call with the same count (or once the
+  // delimiter is found) changes nothing.
+  bool is_chunk_complete(std::size_t chunk_bytes_transferred)
+  {
+    if(!found_)
+    {
+      filled_ = chunk_start_ + chunk_bytes_transferred;
+      search();
+    }
+    return found_;
+  }
+
+  bool has_next_chunk() const
+  {
+    return !found_;
+  }
+
+  buffer_type chunk()
+  {
+    return boost::asio::buffer(&buffer_[chunk_start_], chunk_size());
+  }
+
+  // The chunk is full: the read ends without a last call to is_chunk_complete,
+  // so the last bytes are searched here. If the delimiter is still not found,
+  // make room for more bytes.
+  // Throw boost::system::system_error if the message is too long.
+  void next_chunk()
+  {
+    if(!found_)
+    {
+      filled_ = buffer_.size();
+      search();
+      if(found_)
+      {
+        // Empty chunk, the transfer completes without reading.
+        chunk_start_ = buffer_.size();
+        return;
+      }
+      if(buffer_.size() >= max_storage())
+      {
+        throw boost::system::system_error(error::make_error_code(error::message_too_large));
+      }
+      chunk_start_ = filled_;
+      buffer_.resize(std::min(std::max(2 * buffer_.size(), filled_ + read_size_), max_storage()));
+    }
+  }
+
+  // Prepare the buffer for the next message, it starts with the bytes
+  // received after the delimiter.
+  void reset()
+  {
+    std::swap(buffer_, leftover_);
+    // The previous message, its storage is kept for the next leftover.
+    leftover_.clear();
+    filled_ = buffer_.size();
+    chunk_start_ = filled_;
+    search_from_ = 0;
+    found_ = false;
+    buffer_.resize(std::max(filled_, std::min(filled_ + read_size_, max_storage())));
+  }
+
+  /** @return the number of bytes already received for the next message.
+  */
+  std::size_t leftover() const
+  {
+    return leftover_.size();
+  }
+
+  /** Move out the bytes received after the delimiter, they are not part of
+  * the next message anymore.
+  */
+  std::string take_leftover()
+  {
+    std::string bytes;
+    bytes.swap(leftover_);
+    return bytes;
+  }
+
+  data_type& data() { return buffer_; }
+
+ private:
+  // A message and its delimiter must fit.
+  std::size_t max_storage() const
+  {
+    return max_length_ + delimiter_.size();
+  }
+
+  void search()
+  {
+    const std::size_t d = delimiter_.size();
+    const char first = delimiter_[0];
+    while(filled_ >= search_from_ + d)
+    {
+      const char* start = buffer_.data() + search_from_;
+      const char* match = static_cast<const char*>(
+        std::memchr(start, first, filled_ - d + 1 - search_from_));
+      if(match == nullptr)
+      {
+        search_from_ = filled_ - d + 1;
+        return;
+      }
+      std::size_t position = match - buffer_.data();
+      if(std::memcmp(match + 1, delimiter_.data() + 1, d - 1) == 0)
+      {
+        split(position);
+        return;
+      }
+      search_from_ = position + 1;
+    }
+  }
+
+  void split(std::size_t position)
+  {
+    std::size_t end = position + delimiter_.size();
+    leftover_.assign(buffer_, end, filled_ - end);
+    buffer_.resize(position);
+    found_ = true;
+  }
+
+  std::string delimiter_;
+  std::size_t max_length_;
+  std::size_t read_size_;
+  data_type buffer_;
+  std::string leftover_;
+  // Position of the current chunk in buffer_.
+  std::size_t chunk_start_;
+  // Number of bytes received in buffer_.
+  std::size_t filled_;
+  // No delimiter starts before this position.
+  std::size_t search_from_;
+  bool found_;
+};
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_DELIMITED_BUFFER_HPP
@@ -0,0 +1,236 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Receive buffers writing the bytes directly in memory owned by the
+* caller (ring buffers, pre-allocated message slots, ...), so the data doesn't
+* need to be copied out of the buffer provider once received.
+*
+* The memory must stay valid until the transfer is completed or failed.
+*/
+
+#ifndef NEEV_BUFFER_EXTERNAL_BUFFER_HPP
+#define NEEV_BUFFER_EXTERNAL_BUFFER_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/transfer_operation.hpp>
+#include <neev/network_converter.hpp>
+#include <neev/error.hpp>
+#include <boost/system/system_error.hpp>
+#include <cstdint>
+#include <functional>
+
+namespace neev{
+
+class external_receive_buffer;
+
+template <class PrefixType>
+class external_prefixed_receive_buffer;
+
+template <class TransferCategory>
+struct external_buffer;
+
+template <>
+struct external_buffer<receive_op>
+{
+  using type = external_receive_buffer;
+};
+
+template <class PrefixType, class TransferCategory>
+struct external_prefixed_buffer;
+
+template <class PrefixType>
+struct external_prefixed_buffer<PrefixType, receive_op>
+{
+  using type = external_prefixed_receive_buffer<PrefixType>;
+};
+
+template <class TransferCategory>
+using external_prefixed8_buffer = external_prefixed_buffer<std::uint8_t, TransferCategory>;
+
+template <class TransferCategory>
+using external_prefixed16_buffer = external_prefixed_buffer<std::uint16_t, TransferCategory>;
+
+template <class TransferCategory>
+using external_prefixed32_buffer = external_prefixed_buffer<std::uint32_t, TransferCategory>;
+
+/** Receive exactly buffer_size(storage) bytes into storage.
+* In a receive loop, every message is received in the same storage.
+*/
+class external_receive_buffer
+{
+ public:
+  using data_type = boost::asio::mutable_buffer;
+  using buffer_type = boost::asio::mutable_buffers_1;
+  using transfer_category = receive_op;
+
+  explicit external_receive_buffer(const boost::asio::mutable_buffer& storage)
+  : storage_(storage)
+  {}
+
+  external_receive_buffer(external_receive_buffer&&) = delete;
+  external_receive_buffer& operator=(external_receive_buffer&&) = delete;
+
+  external_receive_buffer(const external_receive_buffer&) = delete;
+  external_receive_buffer& operator=(const external_receive_buffer&) = delete;
+
+  boost::optional<std::size_t> size() const
+  {
+    return boost::asio::buffer_size(storage_);
+  }
+
+  std::size_t chunk_size() const
+  {
+    return *size();
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return false;
+  }
+
+  buffer_type chunk()
+  {
+    return buffer_type(storage_);
+  }
+
+  void next_chunk() const
+  {
+    BOOST_ASSERT_MSG(false,
+      "external_receive_buffer::next_chunk: Should not be called "
+      "(only 1 chunk in this buffer).");
+  }
+
+  void reset() {}
+
+  data_type& data() { return storage_; }
+
+ private:
+  data_type storage_;
+};
+
+/** Receive a message prefixed by its size. Once the prefix is received, the
+* allocator is called with the size of the payload and returns the memory in
+* which the payload is received. If the allocator returns an empty buffer
+* (for example when no slot is free), the transfer fails with
+* error::no_buffer_space. If the memory returned is smaller than the
+* payload, it fails with error::message_too_large.
+*
+* data() is the part of the memory holding the payload.
+*/
+template <class PrefixType>
+class external_prefixed_receive_buffer
+{
+ public:
+  using data_type = boost::asio::mutable_buffer;
+  using prefix_type = PrefixType;
+  using buffer_type = boost::asio::mutable_buffers_1;
+  using transfer_category = receive_op;
+  using allocator_type = std::function<boost::asio::mutable_buffer(std::size_t)>;
+
+ private:
+  enum status
+  {
+    PREFIX_CHUNK,
+    DATA_CHUNK
+  };
+
+ public:
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  explicit external_prefixed_receive_buffer(allocator_type allocator)
+  : allocator_(std::move(allocator))
+  , status_(PREFIX_CHUNK)
+  , prefix_(0)
+  {
+    BOOST_ASSERT_MSG(static_cast<bool>(allocator_),
+      "external_prefixed_receive_buffer: The allocator can't be empty.");
+  }
+
+  external_prefixed_receive_buffer(external_prefixed_receive_buffer&&) = delete;
+  external_prefixed_receive_buffer& operator=(external_prefixed_receive_buffer&&) = delete;
+
+  external_prefixed_receive_buffer(const external_prefixed_receive_buffer&) = delete;
+  external_prefixed_receive_buffer& operator=(const external_prefixed_receive_buffer&) = delete;
+
+  // If the full-size is not known, return nullopt.
+  boost::optional<std::size_t> size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::optional<std::size_t>();
+    else
+      return sizeof(prefix_type) + boost::asio::buffer_size(data_);
+  }
+
+  std::size_t chunk_size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return sizeof(prefix_type);
+    else
+      return boost::asio::buffer_size(data_);
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return status_ != DATA_CHUNK;
+  }
+
+  buffer_type chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::asio::buffer(reinterpret_cast<char*>(&prefix_), sizeof(prefix_type));
+    else
+      return buffer_type(data_);
+  }
+
+  // Post: No effect if there is no next chunk.
+  // Throw boost::system::system_error if the allocator doesn't return enough memory.
+  void next_chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+    {
+      std::size_t payload_size = ntoh(prefix_);
+      boost::asio::mutable_buffer storage = allocator_(payload_size);
+      std::size_t storage_size = boost::asio::buffer_size(storage);
+      if(storage_size < payload_size)
+      {
+        throw boost::system::system_error(error::make_error_code(
+          storage_size == 0 ? error::no_buffer_space : error::message_too_large));
+      }
+      data_ = boost::asio::buffer(storage, payload_size);
+      status_ = DATA_CHUNK;
+    }
+  }
+
+  // Prepare the buffer for the next message, the allocator is called again.
+  void reset()
+  {
+    status_ = PREFIX_CHUNK;
+    prefix_ = 0;
+    data_ = data_type();
+  }
+
+  data_type& data() { return data_; }
+
+ private:
+  allocator_type allocator_;
+  status status_;
+  prefix_type prefix_;
+  data_type data_;
+};
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_EXTERNAL_BUFFER_HPP
@@ -0,0 +1,340 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Send the content of a file without copying it in user space.
+* Only available on Linux, it relies on sendfile(2).
+*/
+
+#ifndef NEEV_BUFFER_FILE_BUFFER_HPP
+#define NEEV_BUFFER_FILE_BUFFER_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/transfer_operation.hpp>
+#include <neev/network_converter.hpp>
+#include <boost/asio.hpp>
+#include <boost/assert.hpp>
+#include <boost/system/system_error.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <cerrno>
+#else
+#error "neev/buffer/file_buffer.hpp: sendfile is only supported on Linux."
+#endif
+
+namespace neev{
+
+/** Transfer category of the buffers sent with sendfile.
+* It is a send operation, the observers receive it as a send_op.
+*/
+struct sendfile_op : send_op {};
+
+/** Region of an open file. The file descriptor is not owned.
+*/
+struct file_range
+{
+  int fd;
+  std::uint64_t offset;
+  std::size_t size;
+};
+
+/** What a sendfile operation transfers: a small header from memory
+* (the prefix, possibly empty) followed by a region of a file.
+*/
+struct file_chunk
+{
+  boost::asio::const_buffer header;
+  file_range file;
+};
+
+namespace detail{
+
+  template <class Socket, class CompletionCondition, class CompletionHandler>
+  class sendfile_operation
+  {
+  public:
+    sendfile_operation(Socket& socket, const file_chunk& chunk,
+      CompletionCondition completion_condition, CompletionHandler completion_handler)
+    : socket_(socket)
+    , chunk_(chunk)
+    , completion_condition_(completion_condition)
+    , completion_handler_(completion_handler)
+    , total_transferred_(0)
+    {}
+
+    void operator()(boost::system::error_code error, std::size_t /*ready*/)
+    {
+      if(!error && !socket_.native_non_blocking())
+      {
+        socket_.native_non_blocking(true, error);
+      }
+      std::size_t header_size = boost::asio::buffer_size(chunk_.header);
+      std::size_t max_size = 0;
+      while(!error && (max_size = completion_condition_(error, total_transferred_)) != 0)
+      {
+        std::size_t n = 0;
+        if(total_transferred_ < header_size)
+        {
+          // Not write_some: it would wait for the socket if it is not in
+          // user non-blocking mode. MSG_MORE holds the header back so it
+          // leaves in the same segment as the beginning of the file.
+          boost::asio::const_buffer header = chunk_.header + total_transferred_;
+          int flags = MSG_NOSIGNAL | (chunk_.file.size != 0 ? MSG_MORE : 0);
+          ssize_t sent = ::send(socket_.native_handle(),
+            boost::asio::buffer_cast<const void*>(header), boost::asio::buffer_size(header), flags);
+          if(sent < 0)
+          {
+            error = boost::system::error_code(errno, boost::asio::error::get_system_category());
+          }
+          else
+          {
+            n = static_cast<std::size_t>(sent);
+          }
+        }
+        else
+        {
+          std::size_t file_sent = total_transferred_ - header_size;
+          off_t offset = static_cast<off_t>(chunk_.file.offset + file_sent);
+          std::size_t count = std::min(max_size, chunk_.file.size - file_sent);
+          errno = 0;
+          ssize_t sent = ::sendfile(socket_.native_handle(), chunk_.file.fd, &offset, count);
+          if(sent < 0)
+          {
+            error = boost::system::error_code(errno, boost::asio::error::get_system_category());
+          }
+          else if(sent == 0)
+          {
+            // The file is shorter than announced.
+            error = boost::asio::error::make_error_code(boost::asio::error::eof);
+          }
+          else
+          {
+            n = static_cast<std::size_t>(sent);
+          }
+        }
+        total_transferred_ += n;
+        if(error == boost::asio::error::interrupted)
+        {
+          error = boost::system::error_code();
+        }
+        else if(error == boost::asio::error::would_block || error == boost::asio::error::try_again)
+        {
+          // Wait for the socket to become ready again.
+          socket_.async_write_some(boost::asio::null_buffers(), *this);
+          return;
+        }
+      }
+      completion_handler_(error, total_transferred_);
+    }
+
+    friend void* asio_handler_allocate(std::size_t size, sendfile_operation* this_handler)
+    {
+      return boost_asio_handler_alloc_helpers::allocate(size, this_handler->completion_handler_);
+    }
+
+    friend void asio_handler_deallocate(void* pointer, std::size_t size, sendfile_operation* this_handler)
+    {
+      boost_asio_handler_alloc_helpers::deallocate(pointer, size, this_handler->completion_handler_);
+    }
+
+    template <class Function>
+    friend void asio_handler_invoke(Function& function, sendfile_operation* this_handler)
+    {
+      boost_asio_handler_invoke_helpers::invoke(function, this_handler->completion_handler_);
+    }
+
+  private:
+    Socket& socket_;
+    file_chunk chunk_;
+    CompletionCondition completion_condition_;
+    CompletionHandler completion_handler_;
+    std::size_t total_transferred_;
+  };
+} // namespace detail
+
+template <>
+struct transfer<sendfile_op>
+{
+  using transfer_category = sendfile_op;
+
+  template <class AsyncStream, class CompletionCondition, class CompletionHandler>
+  static void async_transfer(AsyncStream& socket, const file_chunk& chunk,
+    CompletionCondition completion_condition, CompletionHandler completion_handler)
+  {
+    // The first attempt happens once the socket is ready for writing.
+    socket.async_write_some(boost::asio::null_buffers(),
+      detail::sendfile_operation<AsyncStream, CompletionCondition, CompletionHandler>(
+        socket, chunk, completion_condition, completion_handler));
+  }
+};
+
+template <class PrefixType>
+class file_send_buffer;
+
+class raw_file_send_buffer;
+
+template <class PrefixType, class TransferCategory>
+struct file_buffer;
+
+template <class PrefixType>
+struct file_buffer<PrefixType, send_op>
+{
+  using type = file_send_buffer<PrefixType>;
+};
+
+template <class TransferCategory>
+using file8_buffer = file_buffer<std::uint8_t, TransferCategory>;
+
+template <class TransferCategory>
+using file16_buffer = file_buffer<std::uint16_t, TransferCategory>;
+
+template <class TransferCategory>
+using file32_buffer = file_buffer<std::uint32_t, TransferCategory>;
+
+template <class TransferCategory>
+using file64_buffer = file_buffer<std::uint64_t, TransferCategory>;
+
+template <class TransferCategory>
+struct raw_file_buffer;
+
+template <>
+struct raw_file_buffer<send_op>
+{
+  using type = raw_file_send_buffer;
+};
+
+namespace detail{
+
+  inline std::size_t file_size(int fd)
+  {
+    struct stat file_stat;
+    if(::fstat(fd, &file_stat) != 0)
+    {
+      throw boost::system::system_error(
+        boost::system::error_code(errno, boost::asio::error::get_system_category()),
+        "file_send_buffer");
+    }
+    return static_cast<std::size_t>(file_stat.st_size);
+  }
+
+  /** Buffer provider sending a header followed by a file region with sendfile.
+  */
+  class basic_file_send_buffer
+  {
+   public:
+    using data_type = file_range;
+    using buffer_type = file_chunk;
+    using transfer_category = sendfile_op;
+
+    basic_file_send_buffer(const file_range& file, boost::asio::const_buffer header)
+    : file_(file)
+    , header_(header)
+    {}
+
+    basic_file_send_buffer(basic_file_send_buffer&&) = delete;
+    basic_file_send_buffer& operator=(basic_file_send_buffer&&) = delete;
+
+    basic_file_send_buffer(const basic_file_send_buffer&) = delete;
+    basic_file_send_buffer& operator=(const basic_file_send_buffer&) = delete;
+
+    boost::optional<std::size_t> size() const
+    {
+      return boost::asio::buffer_size(header_) + file_.size;
+    }
+
+    std::size_t chunk_size() const
+    {
+      return *size();
+    }
+
+    bool is_chunk_complete(std::size_t) const
+    {
+      return false;
+    }
+
+    bool has_next_chunk() const
+    {
+      return false;
+    }
+
+    void next_chunk() const
+    {
+      BOOST_ASSERT_MSG(false,
+        "file_send_buffer::next_chunk: Should not be called "
+        "(only 1 chunk in this buffer).");
+    }
+
+    buffer_type chunk() const
+    {
+      return buffer_type{header_, file_};
+    }
+
+    const data_type& data() const { return file_; }
+
+   private:
+    file_range file_;
+    boost::asio::const_buffer header_;
+  };
+} // namespace detail
+
+/** Send a region of a file preceded by its size, the file is pushed by the
+* kernel with sendfile and never copied in user space.
+* The frame can be received by a prefixed_receive_buffer with the same prefix type.
+* @note The file descriptor must stay open until the end of the transfer.
+*/
+template <class PrefixType>
+class file_send_buffer
+: public detail::basic_file_send_buffer
+{
+ public:
+  using prefix_type = PrefixType;
+
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  /** Send the whole file.
+  */
+  explicit file_send_buffer(int fd)
+  : file_send_buffer(fd, 0, detail::file_size(fd))
+  {}
+
+  file_send_buffer(int fd, std::uint64_t offset, std::size_t size)
+  : detail::basic_file_send_buffer(file_range{fd, offset, size},
+      boost::asio::buffer(&prefix_, sizeof(prefix_type)))
+  , prefix_(hton(static_cast<prefix_type>(size)))
+  {
+    BOOST_ASSERT_MSG(std::numeric_limits<prefix_type>::max() >= size,
+      "file_send_buffer: Try to send data which size is too large "
+      "(choose a larger prefix type).");
+  }
+
+ private:
+  prefix_type prefix_;
+};
+
+/** Send a region of a file without prefix, the receiver must know its size.
+* @note The file descriptor must stay open until the end of the transfer.
+*/
+class raw_file_send_buffer
+: public detail::basic_file_send_buffer
+{
+ public:
+  explicit raw_file_send_buffer(int fd)
+  : raw_file_send_buffer(fd, 0, detail::file_size(fd))
+  {}
+
+  raw_file_send_buffer(int fd, std::uint64_t offset, std::size_t size)
+  : detail::basic_file_send_buffer(file_range{fd, offset, size}, boost::asio::const_buffer())
+  {}
+};
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_FILE_BUFFER_HPP
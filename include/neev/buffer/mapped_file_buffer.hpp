@@ -0,0 +1,374 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Receive a prefixed message directly into a memory-mapped file.
+* Only available on POSIX systems, it relies on mmap(2).
+*/
+
+#ifndef NEEV_BUFFER_MAPPED_FILE_BUFFER_HPP
+#define NEEV_BUFFER_MAPPED_FILE_BUFFER_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/transfer_operation.hpp>
+#include <neev/network_converter.hpp>
+#include <neev/error.hpp>
+#include <boost/asio.hpp>
+#include <boost/assert.hpp>
+#include <boost/system/system_error.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cerrno>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace neev{
+
+/** Movable handle on a file mapped in memory, the file is unmapped and
+* closed on destruction.
+*/
+class mapped_file
+{
+ public:
+  enum flags
+  {
+    none = 0,
+    /** Start the write-back of each chunk as soon as it is received (msync with MS_ASYNC). */
+    flush_chunks = 1,
+    /** The file is written sequentially (madvise with MADV_SEQUENTIAL). */
+    sequential = 2
+  };
+
+  mapped_file()
+  : fd_(-1)
+  , address_(nullptr)
+  , size_(0)
+  {}
+
+  /** Create (or truncate) the file at path, allocate size bytes on the disk and map it.
+  * The blocks are allocated up-front: writing to a sparse mapping on a full
+  * disk would raise SIGBUS instead of failing here.
+  * @throw boost::system::system_error if one of the system calls fails.
+  */
+  mapped_file(const std::string& path, std::size_t size, int flags = none)
+  : path_(path)
+  , fd_(::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644))
+  , address_(nullptr)
+  , size_(size)
+  {
+    if(fd_ == -1)
+    {
+      throw_last_error("mapped_file: open");
+    }
+    // A mapping can't be empty, an empty file is just not mapped.
+    if(size_ != 0)
+    {
+      // posix_fallocate doesn't set errno, it returns the error.
+      int error = ::posix_fallocate(fd_, 0, static_cast<off_t>(size_));
+      if(error != 0)
+      {
+        errno = error;
+        close_quietly();
+        throw_last_error("mapped_file: posix_fallocate");
+      }
+      void* address = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+      if(address == MAP_FAILED)
+      {
+        close_quietly();
+        throw_last_error("mapped_file: mmap");
+      }
+      address_ = static_cast<char*>(address);
+      if(flags & sequential)
+      {
+        ::madvise(address_, size_, MADV_SEQUENTIAL);
+      }
+    }
+  }
+
+  mapped_file(mapped_file&& other)
+  : path_(std::move(other.path_))
+  , fd_(other.fd_)
+  , address_(other.address_)
+  , size_(other.size_)
+  {
+    other.fd_ = -1;
+    other.address_ = nullptr;
+    other.size_ = 0;
+  }
+
+  mapped_file& operator=(mapped_file&& other)
+  {
+    if(this != &other)
+    {
+      release();
+      path_ = std::move(other.path_);
+      fd_ = other.fd_;
+      address_ = other.address_;
+      size_ = other.size_;
+      other.fd_ = -1;
+      other.address_ = nullptr;
+      other.size_ = 0;
+    }
+    return *this;
+  }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  ~mapped_file()
+  {
+    release();
+  }
+
+  bool is_open() const { return fd_ != -1; }
+  const std::string& path() const { return path_; }
+  int native_handle() const { return fd_; }
+  char* data() { return address_; }
+  const char* data() const { return address_; }
+  std::size_t size() const { return size_; }
+
+  /** Write the mapped region to the file and wait for the end of the write.
+  * @throw boost::system::system_error if msync fails.
+  */
+  void sync()
+  {
+    if(address_ != nullptr && ::msync(address_, size_, MS_SYNC) != 0)
+    {
+      throw_last_error("mapped_file: msync");
+    }
+  }
+
+  /** Start the write-back of [offset, offset+length) without waiting for it.
+  * @throw boost::system::system_error if msync fails.
+  */
+  void async_sync(std::size_t offset, std::size_t length)
+  {
+    if(address_ == nullptr || length == 0)
+    {
+      return;
+    }
+    // msync needs an address aligned on a page.
+    static const std::size_t page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    std::size_t first = offset - offset % page_size;
+    if(::msync(address_ + first, offset + length - first, MS_ASYNC) != 0)
+    {
+      throw_last_error("mapped_file: msync");
+    }
+  }
+
+ private:
+  static void throw_last_error(const char* what)
+  {
+    throw boost::system::system_error(
+      boost::system::error_code(errno, boost::asio::error::get_system_category()), what);
+  }
+
+  void close_quietly()
+  {
+    int error = errno;
+    ::close(fd_);
+    fd_ = -1;
+    errno = error;
+  }
+
+  void release()
+  {
+    if(address_ != nullptr)
+    {
+      ::munmap(address_, size_);
+      address_ = nullptr;
+    }
+    if(fd_ != -1)
+    {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  std::string path_;
+  int fd_;
+  char* address_;
+  std::size_t size_;
+};
+
+template <class PrefixType>
+class mapped_file_receive_buffer;
+
+template <class PrefixType, class TransferCategory>
+struct mapped_file_buffer;
+
+template <class PrefixType>
+struct mapped_file_buffer<PrefixType, receive_op>
+{
+  using type = mapped_file_receive_buffer<PrefixType>;
+};
+
+template <class TransferCategory>
+using mapped_file8_buffer = mapped_file_buffer<std::uint8_t, TransferCategory>;
+
+template <class TransferCategory>
+using mapped_file16_buffer = mapped_file_buffer<std::uint16_t, TransferCategory>;
+
+template <class TransferCategory>
+using mapped_file32_buffer = mapped_file_buffer<std::uint32_t, TransferCategory>;
+
+template <class TransferCategory>
+using mapped_file64_buffer = mapped_file_buffer<std::uint64_t, TransferCategory>;
+
+/** Receive a prefixed message into a file.
+*
+* Once the prefix is received, the file is created with the announced size
+* and mapped in memory, then the message is received directly into the
+* mapping by chunks of at most max_chunk_size bytes.
+* The data of the transfer is the mapped_file, it can be moved out by the
+* observer in transfer_complete.
+* A prefix announcing more than max_size bytes fails the transfer with
+* error::message_too_large before the file is created.
+* If the file can't be created or its blocks allocated (disk full), the
+* transfer fails with the error of the system call.
+*/
+template <class PrefixType>
+class mapped_file_receive_buffer
+{
+ public:
+  using data_type = mapped_file;
+  using prefix_type = PrefixType;
+  using buffer_type = boost::asio::mutable_buffers_1;
+  using transfer_category = receive_op;
+
+ private:
+  enum status
+  {
+    PREFIX_CHUNK,
+    DATA_CHUNK
+  };
+
+ public:
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  static constexpr std::size_t default_chunk_size = 1024 * 1024;
+
+  /** @param max_size The largest message accepted, it is the space that a
+  * peer can claim on the disk.
+  * @param flags A combination of mapped_file::flags.
+  */
+  mapped_file_receive_buffer(const std::string& path, std::size_t max_size,
+    std::size_t max_chunk_size = default_chunk_size,
+    int flags = mapped_file::sequential)
+  : path_(path)
+  , max_size_(max_size)
+  , max_chunk_size_(max_chunk_size)
+  , flags_(flags)
+  , status_(PREFIX_CHUNK)
+  , prefix_(0)
+  , offset_(0)
+  , flushed_(false)
+  {
+    BOOST_ASSERT_MSG(max_chunk_size_ != 0,
+      "mapped_file_receive_buffer: The chunk size can't be 0.");
+  }
+
+  mapped_file_receive_buffer(mapped_file_receive_buffer&&) = delete;
+  mapped_file_receive_buffer& operator=(mapped_file_receive_buffer&&) = delete;
+
+  mapped_file_receive_buffer(const mapped_file_receive_buffer&) = delete;
+  mapped_file_receive_buffer& operator=(const mapped_file_receive_buffer&) = delete;
+
+  // If the full-size is not known, return nullopt.
+  boost::optional<std::size_t> size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::optional<std::size_t>();
+    else
+      return sizeof(prefix_type) + file_.size();
+  }
+
+  std::size_t chunk_size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return sizeof(prefix_type);
+    else
+      return std::min(max_chunk_size_, file_.size() - offset_);
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return status_ == PREFIX_CHUNK || offset_ + chunk_size() < file_.size();
+  }
+
+  buffer_type chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::asio::buffer(reinterpret_cast<char*>(&prefix_), sizeof(prefix_type));
+    else
+      return boost::asio::buffer(file_.data() + offset_, chunk_size());
+  }
+
+  // Post: No effect if there is no next chunk.
+  // Throw boost::system::system_error if the message is too large, or if the
+  // file can't be created or synced.
+  void next_chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+    {
+      prefix_type size = ntoh(prefix_);
+      if(size > max_size_)
+      {
+        throw boost::system::system_error(error::make_error_code(error::message_too_large));
+      }
+      file_ = mapped_file(path_, size, flags_);
+      status_ = DATA_CHUNK;
+    }
+    else if(has_next_chunk())
+    {
+      std::size_t received = chunk_size();
+      if(flags_ & mapped_file::flush_chunks)
+      {
+        file_.async_sync(offset_, received);
+      }
+      offset_ += received;
+    }
+  }
+
+  // Only called once the message is received, the last chunk is flushed
+  // like the previous ones.
+  // Throw boost::system::system_error if the file can't be synced.
+  data_type& data()
+  {
+    if(!flushed_ && (flags_ & mapped_file::flush_chunks))
+    {
+      flushed_ = true;
+      file_.async_sync(offset_, file_.size() - offset_);
+    }
+    return file_;
+  }
+
+ private:
+  std::string path_;
+  std::size_t max_size_;
+  std::size_t max_chunk_size_;
+  int flags_;
+  status status_;
+  prefix_type prefix_;
+  std::size_t offset_;
+  bool flushed_;
+  data_type file_;
+};
+
+template <class PrefixType>
+constexpr std::size_t mapped_file_receive_buffer<PrefixType>::default_chunk_size;
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_MAPPED_FILE_BUFFER_HPP
@@ -0,0 +1,290 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Fixed-size messages made of a trivially copyable struct.
+*
+* The struct is sent as it is in memory, each field in network byte order.
+* The fields are described at compile time by specializing pod_layout, in
+* the order of their declaration:
+*
+*   namespace neev{
+*   template <>
+*   struct pod_layout<position>
+*   : pod_fields<NEEV_POD_FIELD(position, x), NEEV_POD_FIELD(position, y), NEEV_POD_FIELD(position, z)>
+*   {};
+*   }
+*
+* The size of the message is known by both peers, so it has no prefix.
+*/
+
+#ifndef NEEV_BUFFER_POD_BUFFER_HPP
+#define NEEV_BUFFER_POD_BUFFER_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/transfer_operation.hpp>
+#include <neev/network_converter.hpp>
+#include <cstddef>
+#include <type_traits>
+
+namespace neev{
+
+/** Integral field of a struct T, designated by a pointer to member and
+* its offset in T.
+*/
+template <class MemberPointer, MemberPointer Member, std::size_t Offset>
+struct pod_field;
+
+template <class T, class FieldType, FieldType T::*Member, std::size_t Offset>
+struct pod_field<FieldType T::*, Member, Offset>
+{
+  using struct_type = T;
+  using field_type = FieldType;
+  static constexpr std::size_t offset = Offset;
+
+  static_assert(std::is_integral<field_type>::value,
+    "pod_field: Only integral fields can be converted to network byte order.");
+
+  static void hton(struct_type& value)
+  {
+    mhton(value.*Member);
+  }
+
+  static void ntoh(struct_type& value)
+  {
+    mntoh(value.*Member);
+  }
+};
+
+#define NEEV_POD_FIELD(Type, member) \
+  ::neev::pod_field<decltype(&Type::member), &Type::member, offsetof(Type, member)>
+
+/** List of the fields of a struct, they must follow each other and cover
+* all its bytes.
+*/
+template <class... Fields>
+struct pod_fields;
+
+template <class Field, class... Fields>
+struct pod_fields<Field, Fields...>
+{
+  using struct_type = typename Field::struct_type;
+
+  /** @return the end of the fields if each one starts where the previous
+  * one ends (the first one at offset), std::size_t(-1) otherwise.
+  */
+  static constexpr std::size_t contiguous_end(std::size_t offset)
+  {
+    return Field::offset == offset
+      ? pod_fields<Fields...>::contiguous_end(offset + sizeof(typename Field::field_type))
+      : std::size_t(-1);
+  }
+
+  static void hton(struct_type& value)
+  {
+    Field::hton(value);
+    pod_fields<Fields...>::hton(value);
+  }
+
+  static void ntoh(struct_type& value)
+  {
+    Field::ntoh(value);
+    pod_fields<Fields...>::ntoh(value);
+  }
+};
+
+template <>
+struct pod_fields<>
+{
+  static constexpr std::size_t contiguous_end(std::size_t offset)
+  {
+    return offset;
+  }
+
+  template <class T>
+  static void hton(T&) {}
+
+  template <class T>
+  static void ntoh(T&) {}
+};
+
+/** Field description of T, to specialize with pod_fields.
+*/
+template <class T>
+struct pod_layout;
+
+namespace detail{
+
+  template <class T>
+  struct check_pod_layout
+  {
+    static_assert(std::is_trivially_copyable<T>::value,
+      "pod_buffer: The type must be trivially copyable.");
+    static_assert(std::is_standard_layout<T>::value,
+      "pod_buffer: The type must be standard-layout.");
+    static_assert(pod_layout<T>::contiguous_end(0) == sizeof(T),
+      "pod_buffer: The fields of the layout don't cover the whole type in order "
+      "(missing, repeated or unordered field, or padding).");
+  };
+} // namespace detail
+
+template <class T>
+class pod_send_buffer;
+
+template <class T>
+class pod_receive_buffer;
+
+template <class T, class TransferCategory>
+struct pod_buffer;
+
+template <class T>
+struct pod_buffer<T, send_op>
+{
+  using type = pod_send_buffer<T>;
+};
+
+template <class T>
+struct pod_buffer<T, receive_op>
+{
+  using type = pod_receive_buffer<T>;
+};
+
+template <class T>
+class pod_send_buffer
+: private detail::check_pod_layout<T>
+{
+ public:
+  using data_type = T;
+  using buffer_type = boost::asio::const_buffers_1;
+  using transfer_category = send_op;
+
+  pod_send_buffer(const data_type& data)
+  : data_(data)
+  , wire_(data)
+  {
+    pod_layout<data_type>::hton(wire_);
+  }
+
+  pod_send_buffer(pod_send_buffer&&) = delete;
+  pod_send_buffer& operator=(pod_send_buffer&&) = delete;
+
+  pod_send_buffer(const pod_send_buffer&) = delete;
+  pod_send_buffer& operator=(const pod_send_buffer&) = delete;
+
+  boost::optional<std::size_t> size() const
+  {
+    return sizeof(data_type);
+  }
+
+  std::size_t chunk_size() const
+  {
+    return sizeof(data_type);
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return false;
+  }
+
+  void next_chunk() const
+  {
+    BOOST_ASSERT_MSG(false,
+      "pod_send_buffer::next_chunk: Should not be called "
+      "(only 1 chunk in this buffer).");
+  }
+
+  buffer_type chunk() const
+  {
+    return boost::asio::buffer(&wire_, sizeof(data_type));
+  }
+
+  const data_type& data() const { return data_; }
+
+ private:
+  data_type data_;
+  data_type wire_;
+};
+
+/** Receive the struct in place, its fields are converted to host byte order
+* the first time data() is called.
+*/
+template <class T>
+class pod_receive_buffer
+: private detail::check_pod_layout<T>
+{
+ public:
+  using data_type = T;
+  using buffer_type = boost::asio::mutable_buffers_1;
+  using transfer_category = receive_op;
+
+  pod_receive_buffer()
+  : converted_(false)
+  {}
+
+  pod_receive_buffer(pod_receive_buffer&&) = delete;
+  pod_receive_buffer& operator=(pod_receive_buffer&&) = delete;
+
+  pod_receive_buffer(const pod_receive_buffer&) = delete;
+  pod_receive_buffer& operator=(const pod_receive_buffer&) = delete;
+
+  boost::optional<std::size_t> size() const
+  {
+    return sizeof(data_type);
+  }
+
+  std::size_t chunk_size() const
+  {
+    return sizeof(data_type);
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return false;
+  }
+
+  void next_chunk() const
+  {
+    BOOST_ASSERT_MSG(false,
+      "pod_receive_buffer::next_chunk: Should not be called "
+      "(only 1 chunk in this buffer).");
+  }
+
+  buffer_type chunk()
+  {
+    return boost::asio::buffer(&data_, sizeof(data_type));
+  }
+
+  void reset()
+  {
+    converted_ = false;
+  }
+
+  data_type& data()
+  {
+    if(!converted_)
+    {
+      pod_layout<data_type>::ntoh(data_);
+      converted_ = true;
+    }
+    return data_;
+  }
+
+ private:
+  data_type data_;
+  bool converted_;
+};
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_POD_BUFFER_HPP
@@ -0,0 +1,140 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#ifndef NEEV_BUFFER_POOLED_BUFFER_HPP
+#define NEEV_BUFFER_POOLED_BUFFER_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/transfer_operation.hpp>
+#include <neev/network_converter.hpp>
+#include <neev/slab_pool.hpp>
+#include <cstdint>
+
+namespace neev{
+
+template <class PrefixType>
+class pooled_prefixed_receive_buffer;
+
+template <class PrefixType, class TransferCategory>
+struct pooled_prefixed_buffer;
+
+template <class PrefixType>
+struct pooled_prefixed_buffer<PrefixType, receive_op>
+{
+  using type = pooled_prefixed_receive_buffer<PrefixType>;
+};
+
+template <class TransferCategory>
+using pooled_prefixed8_buffer = pooled_prefixed_buffer<std::uint8_t, TransferCategory>;
+
+template <class TransferCategory>
+using pooled_prefixed16_buffer = pooled_prefixed_buffer<std::uint16_t, TransferCategory>;
+
+template <class TransferCategory>
+using pooled_prefixed32_buffer = pooled_prefixed_buffer<std::uint32_t, TransferCategory>;
+
+/** Receive the messages sent by a prefixed_send_buffer into pooled_bytes.
+*
+* The payload is stored in a block of the slab pool of the receiving thread,
+* it is neither zero-initialized nor copied. The observer can move the
+* pooled_bytes out in transfer_complete, the block goes back to the pool when
+* it is destroyed. Otherwise the block is reused for the next message.
+*/
+template <class PrefixType>
+class pooled_prefixed_receive_buffer
+{
+ public:
+  using data_type = pooled_bytes;
+  using prefix_type = PrefixType;
+  using buffer_type = boost::asio::mutable_buffers_1;
+  using transfer_category = receive_op;
+
+ private:
+  enum status
+  {
+    PREFIX_CHUNK,
+    DATA_CHUNK
+  };
+
+ public:
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  pooled_prefixed_receive_buffer()
+  : status_(PREFIX_CHUNK)
+  , prefix_(0)
+  , data_()
+  {}
+
+  pooled_prefixed_receive_buffer(pooled_prefixed_receive_buffer&&) = delete;
+  pooled_prefixed_receive_buffer& operator=(pooled_prefixed_receive_buffer&&) = delete;
+
+  pooled_prefixed_receive_buffer(const pooled_prefixed_receive_buffer&) = delete;
+  pooled_prefixed_receive_buffer& operator=(const pooled_prefixed_receive_buffer&) = delete;
+
+  // If the full-size is not known, return nullopt.
+  boost::optional<std::size_t> size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::optional<std::size_t>();
+    else
+      return sizeof(prefix_type) + data_.size();
+  }
+
+  std::size_t chunk_size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return sizeof(prefix_type);
+    else
+      return data_.size();
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return status_ != DATA_CHUNK;
+  }
+
+  buffer_type chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::asio::buffer(reinterpret_cast<char*>(&prefix_), sizeof(prefix_type));
+    else
+      return boost::asio::buffer(data_.data(), data_.size());
+  }
+
+  // Post: No effect if there is no next chunk.
+  void next_chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+    {
+      data_.resize(ntoh(prefix_));
+      status_ = DATA_CHUNK;
+    }
+  }
+
+  // Prepare the buffer for the next message, the block is kept if the
+  // observer didn't take it.
+  void reset()
+  {
+    status_ = PREFIX_CHUNK;
+    prefix_ = 0;
+  }
+
+  data_type& data() { return data_; }
+
+ private:
+  status status_;
+  prefix_type prefix_;
+  data_type data_;
+};
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_POOLED_BUFFER_HPP
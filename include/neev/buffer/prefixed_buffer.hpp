@@ -131,21 +131,14 @@ class prefixed_receive_buffer
     DATA_CHUNK
   };
 
-  union storage
-  {
-    prefix_type prefix_;
-    data_type data_;
-    storage() : prefix_(0) {}
-    ~storage() {}
-  };
-
  public:
   static_assert(std::is_unsigned<prefix_type>::value, 
     "The buffer size will never be negative.");
 
   prefixed_receive_buffer()
   : status_(PREFIX_CHUNK)
-  , storage_()
+  , prefix_(0)
+  , data_()
   {}
 
   prefixed_receive_buffer(prefixed_receive_buffer&&) = delete;
@@ -154,14 +147,6 @@ class prefixed_receive_buffer
   prefixed_receive_buffer(const prefixed_receive_buffer&) = delete;
   prefixed_receive_buffer& operator=(const prefixed_receive_buffer&) = delete;
 
-  ~prefixed_receive_buffer()
-  {
-    if(status_ == DATA_CHUNK)
-    {
-      storage_.data_.~data_type();
-    }
-  }
-
 // !!!!! If iterator, problem to use the status now... or to update the size.
   // If the full-size is not known, return nullopt.
   boost::optional<std::size_t> size() const
@@ -171,7 +156,7 @@ class prefixed_receive_buffer
       case PREFIX_CHUNK:
         return boost::optional<std::size_t>();
       case DATA_CHUNK:
-        return sizeof(prefix_type) + storage_.data_.size();
+        return sizeof(prefix_type) + data_.size();
       default:
         BOOST_ASSERT_MSG(false, 
           "prefixed_receive_buffer::next_chunk: Invalid status.");
@@ -186,7 +171,7 @@ class prefixed_receive_buffer
       case PREFIX_CHUNK:
         return sizeof(prefix_type);
       case DATA_CHUNK:
-        return storage_.data_.size();
+        return data_.size();
       default:
         BOOST_ASSERT_MSG(false, 
           "prefixed_receive_buffer::next_chunk: Invalid status.");
@@ -209,9 +194,9 @@ class prefixed_receive_buffer
     switch(status_)
     {
       case PREFIX_CHUNK:
-        return boost::asio::buffer(reinterpret_cast<char*>(&storage_.prefix_), sizeof(prefix_type));
+        return boost::asio::buffer(reinterpret_cast<char*>(&prefix_), sizeof(prefix_type));
       case DATA_CHUNK:
-        return boost::asio::buffer(&storage_.data_[0], storage_.data_.size());
+        return boost::asio::buffer(&data_[0], data_.size());
       default:
         BOOST_ASSERT_MSG(false, 
           "prefixed_receive_buffer::next_chunk: Invalid status.");
@@ -224,17 +209,26 @@ class prefixed_receive_buffer
   {
     if(status_ == PREFIX_CHUNK)
     {
-      prefix_type prefix = ntoh(storage_.prefix_);
-      new (&storage_.data_) data_type(prefix, 0);
+      // The capacity of the data is kept between messages (see reset()),
+      // so resizing doesn't allocate unless the message is larger.
+      data_.resize(ntoh(prefix_));
       status_ = DATA_CHUNK;
     }
   }
 
-  data_type& data() { return storage_.data_; }
+  // Prepare the buffer for the next message, the data storage is reused.
+  void reset()
+  {
+    status_ = PREFIX_CHUNK;
+    prefix_ = 0;
+  }
+
+  data_type& data() { return data_; }
 
  private:
   status status_;
-  storage storage_;
+  prefix_type prefix_;
+  data_type data_;
 };
 
 } // namespace neev
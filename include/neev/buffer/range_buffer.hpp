@@ -0,0 +1,177 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#ifndef NEEV_BUFFER_RANGE_BUFFER_HPP
+#define NEEV_BUFFER_RANGE_BUFFER_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/transfer_operation.hpp>
+#include <neev/network_converter.hpp>
+#include <boost/assert.hpp>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace neev{
+
+template <class Iterator, class PrefixType>
+class range_send_buffer;
+
+template <class Iterator, class PrefixType, class TransferCategory>
+struct range_buffer;
+
+template <class Iterator, class PrefixType>
+struct range_buffer<Iterator, PrefixType, send_op>
+{
+  using type = range_send_buffer<Iterator, PrefixType>;
+};
+
+template <class Iterator, class TransferCategory>
+using range8_buffer = range_buffer<Iterator, std::uint8_t, TransferCategory>;
+
+template <class Iterator, class TransferCategory>
+using range16_buffer = range_buffer<Iterator, std::uint16_t, TransferCategory>;
+
+template <class Iterator, class TransferCategory>
+using range32_buffer = range_buffer<Iterator, std::uint32_t, TransferCategory>;
+
+template <class Iterator, class TransferCategory>
+using range64_buffer = range_buffer<Iterator, std::uint64_t, TransferCategory>;
+
+/** Stream the elements of a range through a fixed-size staging buffer.
+*
+* The size in bytes of the whole range is sent first as a prefix, then the
+* elements are converted to network byte order and copied in the staging
+* buffer, one chunk at a time. The range is never materialized, so the
+* memory used by the transfer is bounded by the chunk size. Any input
+* range of integral values works, for example a flatten_iterator over
+* nested containers.
+*
+* The frame can be received by a prefixed_receive_buffer with the same prefix type.
+* The data of the transfer is the number of elements of the frame, all of them
+* are sent once transfer_complete is dispatched.
+*/
+template <class Iterator, class PrefixType>
+class range_send_buffer
+{
+ public:
+  using iterator = Iterator;
+  using value_type = typename std::iterator_traits<iterator>::value_type;
+  using data_type = std::size_t;
+  using prefix_type = PrefixType;
+  using buffer_type = boost::asio::const_buffers_1;
+  using transfer_category = send_op;
+
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+  static_assert(std::is_integral<value_type>::value,
+    "range_send_buffer: Only ranges of integral values can be converted to network byte order.");
+
+  static constexpr std::size_t default_chunk_size = 64 * 1024;
+
+  /** Stream [first, last), the distance is computed first.
+  */
+  range_send_buffer(iterator first, iterator last, std::size_t chunk_size = default_chunk_size)
+  : range_send_buffer(first, static_cast<std::size_t>(std::distance(first, last)), chunk_size)
+  {
+    static_assert(std::is_base_of<std::forward_iterator_tag,
+      typename std::iterator_traits<iterator>::iterator_category>::value,
+      "range_send_buffer: [first, last) is traversed twice, use (first, count) with an input iterator.");
+  }
+
+  /** Stream the count elements starting at first, any input iterator is accepted.
+  */
+  range_send_buffer(iterator first, std::size_t count, std::size_t chunk_size = default_chunk_size)
+  : first_(first)
+  , count_(count)
+  , taken_(0)
+  , staging_(std::max(chunk_size, sizeof(prefix_type) + sizeof(value_type)))
+  , staged_(0)
+  {
+    BOOST_ASSERT_MSG(std::numeric_limits<prefix_type>::max() / sizeof(value_type) >= count_,
+      "range_send_buffer: Try to send data which size is too large "
+      "(choose a larger prefix type).");
+    prefix_type prefix = hton(static_cast<prefix_type>(count_ * sizeof(value_type)));
+    std::memcpy(&staging_[0], &prefix, sizeof(prefix_type));
+    fill(sizeof(prefix_type));
+  }
+
+  range_send_buffer(range_send_buffer&&) = delete;
+  range_send_buffer& operator=(range_send_buffer&&) = delete;
+
+  range_send_buffer(const range_send_buffer&) = delete;
+  range_send_buffer& operator=(const range_send_buffer&) = delete;
+
+  boost::optional<std::size_t> size() const
+  {
+    return sizeof(prefix_type) + count_ * sizeof(value_type);
+  }
+
+  std::size_t chunk_size() const
+  {
+    return staged_;
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return taken_ < count_;
+  }
+
+  buffer_type chunk() const
+  {
+    return boost::asio::buffer(&staging_[0], staged_);
+  }
+
+  // Post: No effect if there is no next chunk.
+  void next_chunk()
+  {
+    if(has_next_chunk())
+    {
+      fill(0);
+    }
+  }
+
+  const data_type& data() const { return count_; }
+
+ private:
+  // Copy as many elements as possible in the staging buffer after offset bytes.
+  void fill(std::size_t offset)
+  {
+    std::size_t capacity = (staging_.size() - offset) / sizeof(value_type);
+    std::size_t n = std::min(capacity, count_ - taken_);
+    char* out = &staging_[offset];
+    for(std::size_t i = 0; i < n; ++i, ++first_, out += sizeof(value_type))
+    {
+      value_type value = *first_;
+      mhton(value);
+      std::memcpy(out, &value, sizeof(value_type));
+    }
+    taken_ += n;
+    staged_ = offset + n * sizeof(value_type);
+  }
+
+  iterator first_;
+  std::size_t count_;
+  // Number of elements taken from the range, staged or already sent.
+  std::size_t taken_;
+  std::vector<char> staging_;
+  std::size_t staged_;
+};
+
+template <class Iterator, class PrefixType>
+constexpr std::size_t range_send_buffer<Iterator, PrefixType>::default_chunk_size;
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_RANGE_BUFFER_HPP
@@ -0,0 +1,168 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#ifndef NEEV_BUFFER_READAHEAD_BUFFER_HPP
+#define NEEV_BUFFER_READAHEAD_BUFFER_HPP
+
+#include <neev/network_converter.hpp>
+#include <neev/error.hpp>
+#include <boost/asio.hpp>
+#include <boost/assert.hpp>
+#include <boost/system/system_error.hpp>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace neev{
+
+/** Receive buffer reading ahead as many bytes as the socket has available
+* and splitting them into prefixed frames.
+*
+* The bytes are read in a contiguous storage, the bytes of a partial frame
+* are moved to the front when more space is needed so a frame is always
+* contiguous. The storage only grows when a frame is larger than it.
+* A frame announcing more than max_size bytes is rejected with
+* error::message_too_large before the storage grows for it.
+*/
+template <class PrefixType>
+class readahead_receive_buffer
+{
+ public:
+  using data_type = std::string;
+  using prefix_type = PrefixType;
+  using buffer_type = boost::asio::mutable_buffers_1;
+
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  explicit readahead_receive_buffer(std::size_t read_size = 4096,
+    std::size_t max_size = std::numeric_limits<std::size_t>::max())
+  : storage_(read_size, 0)
+  , begin_(0)
+  , end_(0)
+  , read_size_(read_size)
+  , max_size_(max_size)
+  {
+    BOOST_ASSERT_MSG(read_size_ > sizeof(prefix_type),
+      "readahead_receive_buffer: The read size must be larger than the prefix.");
+  }
+
+  readahead_receive_buffer(readahead_receive_buffer&&) = delete;
+  readahead_receive_buffer& operator=(readahead_receive_buffer&&) = delete;
+
+  readahead_receive_buffer(const readahead_receive_buffer&) = delete;
+  readahead_receive_buffer& operator=(const readahead_receive_buffer&) = delete;
+
+  /** @return the free space where the next read must store its bytes.
+  * It is at least as large as the read size or the missing part of the
+  * pending frame.
+  * @throw boost::system::system_error if the pending frame is too large.
+  */
+  buffer_type prepare()
+  {
+    std::size_t needed = std::max(read_size_, missing_bytes());
+    if(storage_.size() - end_ < needed)
+    {
+      compact();
+      if(storage_.size() - end_ < needed)
+      {
+        storage_.resize(end_ + needed);
+      }
+    }
+    return boost::asio::buffer(&storage_[end_], storage_.size() - end_);
+  }
+
+  /** Make the n bytes read in the space returned by prepare() available to next_frame().
+  */
+  void commit(std::size_t n)
+  {
+    BOOST_ASSERT_MSG(end_ + n <= storage_.size(),
+      "readahead_receive_buffer::commit: More bytes committed than prepared.");
+    end_ += n;
+  }
+
+  /** Extract the next complete frame, its storage is reused if possible.
+  * @return false if no complete frame is buffered yet.
+  * @throw boost::system::system_error if the next frame is too large.
+  */
+  bool next_frame(data_type& frame)
+  {
+    if(buffered() < sizeof(prefix_type))
+    {
+      return false;
+    }
+    std::size_t frame_size = payload_size();
+    if(buffered() < sizeof(prefix_type) + frame_size)
+    {
+      return false;
+    }
+    frame.assign(&storage_[begin_ + sizeof(prefix_type)], frame_size);
+    begin_ += sizeof(prefix_type) + frame_size;
+    if(begin_ == end_)
+    {
+      begin_ = end_ = 0;
+    }
+    return true;
+  }
+
+  /** @return the number of bytes received but not yet extracted.
+  */
+  std::size_t buffered() const
+  {
+    return end_ - begin_;
+  }
+
+ private:
+  std::size_t payload_size() const
+  {
+    prefix_type prefix;
+    std::memcpy(&prefix, &storage_[begin_], sizeof(prefix_type));
+    std::size_t size = ntoh(prefix);
+    if(size > max_size_)
+    {
+      throw boost::system::system_error(error::make_error_code(error::message_too_large));
+    }
+    return size;
+  }
+
+  std::size_t missing_bytes() const
+  {
+    if(buffered() < sizeof(prefix_type))
+    {
+      return 0;
+    }
+    std::size_t frame_size = sizeof(prefix_type) + payload_size();
+    return frame_size > buffered() ? frame_size - buffered() : 0;
+  }
+
+  void compact()
+  {
+    if(begin_ != 0)
+    {
+      std::memmove(&storage_[0], &storage_[begin_], buffered());
+      end_ -= begin_;
+      begin_ = 0;
+    }
+  }
+
+  data_type storage_;
+  std::size_t begin_;
+  std::size_t end_;
+  std::size_t read_size_;
+  std::size_t max_size_;
+};
+
+using readahead8_receive_buffer = readahead_receive_buffer<std::uint8_t>;
+
+using readahead16_receive_buffer = readahead_receive_buffer<std::uint16_t>;
+
+using readahead32_receive_buffer = readahead_receive_buffer<std::uint32_t>;
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_READAHEAD_BUFFER_HPP
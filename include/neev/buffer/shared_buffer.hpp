@@ -0,0 +1,185 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#ifndef NEEV_BUFFER_SHARED_BUFFER_HPP
+#define NEEV_BUFFER_SHARED_BUFFER_HPP
+
+#include <neev/transfer_pool.hpp>
+#include <neev/transfer_operation.hpp>
+#include <neev/network_converter.hpp>
+#include <boost/assert.hpp>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <limits>
+
+namespace neev{
+
+/** Immutable prefixed frame shared by all the transfers sending it.
+* The prefix is encoded once, together with the payload, in a single
+* reference-counted storage. Copying a shared_frame doesn't copy the bytes.
+*/
+template <class PrefixType>
+class shared_frame
+{
+ public:
+  using prefix_type = PrefixType;
+
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  explicit shared_frame(const std::string& payload)
+  : bytes_(encode(payload))
+  {}
+
+  /** @return the frame as it is sent (prefix and payload).
+  */
+  boost::asio::const_buffers_1 buffer() const
+  {
+    return boost::asio::buffer(*bytes_);
+  }
+
+  /** @return the frame size, including the prefix.
+  */
+  std::size_t size() const
+  {
+    return bytes_->size();
+  }
+
+  /** @return a pointer to the first byte of the payload.
+  */
+  const char* payload() const
+  {
+    return bytes_->data() + sizeof(prefix_type);
+  }
+
+  std::size_t payload_size() const
+  {
+    return size() - sizeof(prefix_type);
+  }
+
+ private:
+  static std::shared_ptr<const std::string> encode(const std::string& payload)
+  {
+    BOOST_ASSERT_MSG(std::numeric_limits<prefix_type>::max() >= payload.size(),
+      "shared_frame: Try to send data which size is too large "
+      "(choose a larger prefix type).");
+    // The bytes are written once, without zero-filling the frame first.
+    auto bytes = std::make_shared<std::string>();
+    bytes->reserve(sizeof(prefix_type) + payload.size());
+    prefix_type prefix = hton(static_cast<prefix_type>(payload.size()));
+    bytes->append(reinterpret_cast<const char*>(&prefix), sizeof(prefix_type));
+    bytes->append(payload);
+    return bytes;
+  }
+
+  std::shared_ptr<const std::string> bytes_;
+};
+
+template <class PrefixType>
+shared_frame<PrefixType> make_shared_frame(const std::string& payload)
+{
+  return shared_frame<PrefixType>(payload);
+}
+
+template <class PrefixType>
+class shared_send_buffer;
+
+template <class PrefixType, class TransferCategory>
+struct shared_buffer;
+
+template <class PrefixType>
+struct shared_buffer<PrefixType, send_op>
+{
+  using type = shared_send_buffer<PrefixType>;
+};
+
+template <class TransferCategory>
+using shared8_buffer = shared_buffer<std::uint8_t, TransferCategory>;
+
+template <class TransferCategory>
+using shared16_buffer = shared_buffer<std::uint16_t, TransferCategory>;
+
+template <class TransferCategory>
+using shared32_buffer = shared_buffer<std::uint32_t, TransferCategory>;
+
+/** Send a shared_frame, the buffer only points to the frame.
+* The frame is received with a prefixed_receive_buffer of the same prefix type.
+*/
+template <class PrefixType>
+class shared_send_buffer
+{
+ public:
+  using data_type = shared_frame<PrefixType>;
+  using prefix_type = PrefixType;
+  using buffer_type = boost::asio::const_buffers_1;
+  using transfer_category = send_op;
+
+  explicit shared_send_buffer(const data_type& frame)
+  : frame_(frame)
+  {}
+
+  shared_send_buffer(shared_send_buffer&&) = delete;
+  shared_send_buffer& operator=(shared_send_buffer&&) = delete;
+
+  shared_send_buffer(const shared_send_buffer&) = delete;
+  shared_send_buffer& operator=(const shared_send_buffer&) = delete;
+
+  boost::optional<std::size_t> size() const
+  {
+    return frame_.size();
+  }
+
+  std::size_t chunk_size() const
+  {
+    return *size();
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return false;
+  }
+
+  void next_chunk() const
+  {
+    BOOST_ASSERT_MSG(false,
+      "shared_send_buffer::next_chunk: Should not be called "
+      "(only 1 chunk in this buffer).");
+  }
+
+  buffer_type chunk() const
+  {
+    return frame_.buffer();
+  }
+
+  const data_type& data() const { return frame_; }
+
+ private:
+  data_type frame_;
+};
+
+/** Send the same frame to every socket of a range.
+* Each socket gets its own transfer, taken from the transfer_pool, but they
+* all share the bytes of the frame.
+* @note Use std::ref(observer) to avoid a copy of the observer per socket.
+*/
+template <class PrefixType, class TimerPolicy = no_timer, class SocketRange, class Observer>
+void broadcast(const SocketRange& sockets, const shared_frame<PrefixType>& frame, const Observer& observer)
+{
+  for(const auto& socket : sockets)
+  {
+    make_pooled_transfer<shared_buffer<PrefixType, send_op>, TimerPolicy>(
+      socket, Observer(observer), frame)->async_transfer();
+  }
+}
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_SHARED_BUFFER_HPP
@@ -0,0 +1,299 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Messages prefixed by their size encoded as a LEB128 variable-length integer.
+* A size below 128 takes 1 byte, the largest 64-bit size takes 10 bytes.
+*/
+
+#ifndef NEEV_BUFFER_VARINT_BUFFER_HPP
+#define NEEV_BUFFER_VARINT_BUFFER_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/transfer_operation.hpp>
+#include <neev/error.hpp>
+#include <boost/system/system_error.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace neev{
+
+class varint_prefixed_send_buffer;
+class varint_prefixed_receive_buffer;
+
+template <class TransferCategory>
+struct varint_prefixed_buffer;
+
+template <>
+struct varint_prefixed_buffer<send_op>
+{
+  using type = varint_prefixed_send_buffer;
+};
+
+template <>
+struct varint_prefixed_buffer<receive_op>
+{
+  using type = varint_prefixed_receive_buffer;
+};
+
+namespace detail{
+
+  constexpr std::size_t max_varint_size = 10;
+
+  /** Encode value in LEB128 (7 bits per byte, the least significant first,
+  * the high bit set on every byte but the last).
+  * @return the number of bytes written in out.
+  */
+  inline std::size_t encode_varint(std::uint64_t value, unsigned char* out)
+  {
+    std::size_t n = 0;
+    while(value >= 0x80)
+    {
+      out[n++] = static_cast<unsigned char>(value | 0x80);
+      value >>= 7;
+    }
+    out[n++] = static_cast<unsigned char>(value);
+    return n;
+  }
+} // namespace detail
+
+class varint_prefixed_send_buffer
+{
+ public:
+  using data_type = std::string;
+  using buffer_type = std::array<boost::asio::const_buffers_1, 2>;
+  using transfer_category = send_op;
+
+  varint_prefixed_send_buffer(data_type&& data)
+  : data_(std::move(data))
+  , prefix_size_(detail::encode_varint(data_.size(), prefix_.data()))
+  {}
+
+  varint_prefixed_send_buffer(varint_prefixed_send_buffer&&) = delete;
+  varint_prefixed_send_buffer& operator=(varint_prefixed_send_buffer&&) = delete;
+
+  varint_prefixed_send_buffer(const varint_prefixed_send_buffer&) = delete;
+  varint_prefixed_send_buffer& operator=(const varint_prefixed_send_buffer&) = delete;
+
+  boost::optional<std::size_t> size() const
+  {
+    return prefix_size_ + data_.size();
+  }
+
+  std::size_t chunk_size() const
+  {
+    return *size();
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return false;
+  }
+
+  void next_chunk() const
+  {
+    BOOST_ASSERT_MSG(false,
+      "varint_prefixed_send_buffer::next_chunk: Should not be called "
+      "(only 1 chunk in this buffer).");
+  }
+
+  buffer_type chunk() const
+  {
+    return buffer_type{
+      boost::asio::buffer(prefix_.data(), prefix_size_),
+      boost::asio::buffer(data_)
+    };
+  }
+
+  const data_type& data() const { return data_; }
+
+ private:
+  data_type data_;
+  std::array<unsigned char, detail::max_varint_size> prefix_;
+  std::size_t prefix_size_;
+};
+
+/** Receive the messages sent by a varint_prefixed_send_buffer.
+*
+* The prefix is received in at most two reads: its first byte, then, if the
+* size takes more than one byte, a window of 9 bytes. Since a size encoded in
+* k > 1 bytes is at least 128^(k-1), the message is longer than the window
+* and the bytes following the prefix in it are the beginning of the message.
+* The rest of the message is received in a single chunk.
+*
+* A prefix longer than 10 bytes, not in its shortest form, or a size that
+* doesn't fit in std::size_t, fails the transfer with error::malformed_prefix;
+* a size above max_size fails it with error::message_too_large.
+*/
+class varint_prefixed_receive_buffer
+{
+ public:
+  using data_type = std::string;
+  using buffer_type = boost::asio::mutable_buffers_1;
+  using transfer_category = receive_op;
+
+ private:
+  enum status
+  {
+    PREFIX_CHUNK,
+    DATA_CHUNK
+  };
+
+ public:
+  explicit varint_prefixed_receive_buffer(
+    std::size_t max_size = std::numeric_limits<std::size_t>::max())
+  : max_size_(max_size)
+  , status_(PREFIX_CHUNK)
+  , window_()
+  , window_filled_(0)
+  , prefix_size_(0)
+  , data_start_(0)
+  , data_()
+  {}
+
+  varint_prefixed_receive_buffer(varint_prefixed_receive_buffer&&) = delete;
+  varint_prefixed_receive_buffer& operator=(varint_prefixed_receive_buffer&&) = delete;
+
+  varint_prefixed_receive_buffer(const varint_prefixed_receive_buffer&) = delete;
+  varint_prefixed_receive_buffer& operator=(const varint_prefixed_receive_buffer&) = delete;
+
+  // If the full-size is not known, return nullopt.
+  boost::optional<std::size_t> size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::optional<std::size_t>();
+    else
+      return prefix_size_ + data_.size();
+  }
+
+  // The first byte alone, then the whole window if the prefix goes on.
+  std::size_t chunk_size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return (window_[0] & 0x80) ? window_.size() : 1;
+    else
+      return data_.size() - data_start_;
+  }
+
+  // The prefix is complete once its last byte is received.
+  bool is_chunk_complete(std::size_t chunk_bytes_transferred)
+  {
+    if(status_ == PREFIX_CHUNK)
+    {
+      window_filled_ = chunk_bytes_transferred;
+      return prefix_end() != 0;
+    }
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return status_ != DATA_CHUNK;
+  }
+
+  buffer_type chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::asio::buffer(window_);
+    else
+      return boost::asio::buffer(&data_[data_start_], chunk_size());
+  }
+
+  // Decode the prefix received, the bytes following it in the window are
+  // the first bytes of the message.
+  // Post: No effect if there is no next chunk.
+  // Throw boost::system::system_error if the prefix is invalid or the size too large.
+  void next_chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+    {
+      // The read stops without a last call to is_chunk_complete when the window is full.
+      if(prefix_end() == 0)
+      {
+        window_filled_ = window_.size();
+      }
+      prefix_size_ = prefix_end();
+      std::uint64_t value = decode();
+      if(value > max_size_ || value > data_.max_size())
+      {
+        throw boost::system::system_error(error::make_error_code(error::message_too_large));
+      }
+      data_.resize(static_cast<std::size_t>(value));
+      data_start_ = window_filled_ - prefix_size_;
+      std::copy(window_.begin() + prefix_size_, window_.begin() + window_filled_, data_.begin());
+      status_ = DATA_CHUNK;
+    }
+  }
+
+  // Prepare the buffer for the next message, the data storage is reused.
+  void reset()
+  {
+    status_ = PREFIX_CHUNK;
+    window_[0] = 0;
+    window_filled_ = 0;
+    prefix_size_ = 0;
+    data_start_ = 0;
+  }
+
+  data_type& data() { return data_; }
+
+ private:
+  // @return the size of the prefix, or 0 if its last byte is not received yet.
+  std::size_t prefix_end() const
+  {
+    for(std::size_t i = 0; i < window_filled_; ++i)
+    {
+      if((window_[i] & 0x80) == 0)
+        return i + 1;
+    }
+    return 0;
+  }
+
+  std::uint64_t decode() const
+  {
+    // A prefix of more than one byte ending with a zero byte encodes a
+    // smaller size than its length allows: it is not in its shortest form.
+    if(prefix_size_ == 0 || (prefix_size_ > 1 && window_[prefix_size_ - 1] == 0))
+    {
+      throw boost::system::system_error(error::make_error_code(error::malformed_prefix));
+    }
+    std::uint64_t value = 0;
+    for(std::size_t i = 0; i < prefix_size_; ++i)
+    {
+      std::uint64_t bits = window_[i] & 0x7f;
+      if(i == detail::max_varint_size - 1 && bits > 1)
+      {
+        throw boost::system::system_error(error::make_error_code(error::malformed_prefix));
+      }
+      value |= bits << (7 * i);
+    }
+    if(value > std::numeric_limits<std::size_t>::max())
+    {
+      throw boost::system::system_error(error::make_error_code(error::malformed_prefix));
+    }
+    return value;
+  }
+
+  std::size_t max_size_;
+  status status_;
+  std::array<unsigned char, detail::max_varint_size> window_;
+  // Number of bytes received in the window.
+  std::size_t window_filled_;
+  std::size_t prefix_size_;
+  // Number of bytes of the message received with the prefix.
+  std::size_t data_start_;
+  data_type data_;
+};
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_VARINT_BUFFER_HPP
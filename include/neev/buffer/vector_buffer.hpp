@@ -0,0 +1,241 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#ifndef NEEV_BUFFER_VECTOR_BUFFER_HPP
+#define NEEV_BUFFER_VECTOR_BUFFER_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/transfer_operation.hpp>
+#include <neev/network_converter.hpp>
+#include <neev/error.hpp>
+#include <boost/system/system_error.hpp>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace neev{
+
+template <class T, class PrefixType>
+class vector_send_buffer;
+
+template <class T, class PrefixType>
+class vector_receive_buffer;
+
+template <class T, class PrefixType, class TransferCategory>
+struct vector_buffer;
+
+template <class T, class PrefixType>
+struct vector_buffer<T, PrefixType, send_op>
+{
+  using type = vector_send_buffer<T, PrefixType>;
+};
+
+template <class T, class PrefixType>
+struct vector_buffer<T, PrefixType, receive_op>
+{
+  using type = vector_receive_buffer<T, PrefixType>;
+};
+
+template <class T, class TransferCategory>
+using vector16_buffer = vector_buffer<T, std::uint16_t, TransferCategory>;
+
+template <class T, class TransferCategory>
+using vector32_buffer = vector_buffer<T, std::uint32_t, TransferCategory>;
+
+template <class T, class TransferCategory>
+using vector64_buffer = vector_buffer<T, std::uint64_t, TransferCategory>;
+
+/** Send a vector of numbers of 2, 4 or 8 bytes prefixed by its size in bytes.
+* The elements are converted to network byte order in a single pass into a
+* staging buffer, the data seen by the observer stays in host byte order.
+*/
+template <class T, class PrefixType>
+class vector_send_buffer
+{
+ public:
+  using data_type = std::vector<T>;
+  using prefix_type = PrefixType;
+  using buffer_type = std::array<boost::asio::const_buffers_1, 2>;
+  using transfer_category = send_op;
+
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  vector_send_buffer(data_type&& data)
+  : data_(std::move(data))
+  , prefix_(hton(static_cast<prefix_type>(data_.size() * sizeof(T))))
+  , wire_(data_.size())
+  {
+    BOOST_ASSERT_MSG(std::numeric_limits<prefix_type>::max() / sizeof(T) >= data_.size(),
+      "vector_send_buffer: Try to send data which size is too large "
+      "(choose a larger prefix type).");
+    hton_array(data_.data(), wire_.data(), data_.size());
+  }
+
+  vector_send_buffer(vector_send_buffer&&) = delete;
+  vector_send_buffer& operator=(vector_send_buffer&&) = delete;
+
+  vector_send_buffer(const vector_send_buffer&) = delete;
+  vector_send_buffer& operator=(const vector_send_buffer&) = delete;
+
+  boost::optional<std::size_t> size() const
+  {
+    return sizeof(prefix_type) + data_.size() * sizeof(T);
+  }
+
+  std::size_t chunk_size() const
+  {
+    return *size();
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return false;
+  }
+
+  void next_chunk() const
+  {
+    BOOST_ASSERT_MSG(false,
+      "vector_send_buffer::next_chunk: Should not be called "
+      "(only 1 chunk in this buffer).");
+  }
+
+  buffer_type chunk() const
+  {
+    return buffer_type{
+      boost::asio::buffer(reinterpret_cast<const char*>(&prefix_), sizeof(prefix_)),
+      boost::asio::buffer(wire_)
+    };
+  }
+
+  const data_type& data() const { return data_; }
+
+ private:
+  data_type data_;
+  prefix_type prefix_;
+  data_type wire_;
+};
+
+/** Receive the messages sent by a vector_send_buffer.
+* The elements are received in place and converted to host byte order the
+* first time data() is called. A size that isn't a multiple of sizeof(T)
+* fails the transfer with error::malformed_prefix.
+*/
+template <class T, class PrefixType>
+class vector_receive_buffer
+{
+ public:
+  using data_type = std::vector<T>;
+  using prefix_type = PrefixType;
+  using buffer_type = boost::asio::mutable_buffers_1;
+  using transfer_category = receive_op;
+
+ private:
+  enum status
+  {
+    PREFIX_CHUNK,
+    DATA_CHUNK
+  };
+
+ public:
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  vector_receive_buffer()
+  : status_(PREFIX_CHUNK)
+  , prefix_(0)
+  , converted_(false)
+  {}
+
+  vector_receive_buffer(vector_receive_buffer&&) = delete;
+  vector_receive_buffer& operator=(vector_receive_buffer&&) = delete;
+
+  vector_receive_buffer(const vector_receive_buffer&) = delete;
+  vector_receive_buffer& operator=(const vector_receive_buffer&) = delete;
+
+  // If the full-size is not known, return nullopt.
+  boost::optional<std::size_t> size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::optional<std::size_t>();
+    else
+      return sizeof(prefix_type) + data_.size() * sizeof(T);
+  }
+
+  std::size_t chunk_size() const
+  {
+    if(status_ == PREFIX_CHUNK)
+      return sizeof(prefix_type);
+    else
+      return data_.size() * sizeof(T);
+  }
+
+  bool is_chunk_complete(std::size_t) const
+  {
+    return false;
+  }
+
+  bool has_next_chunk() const
+  {
+    return status_ != DATA_CHUNK;
+  }
+
+  buffer_type chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+      return boost::asio::buffer(reinterpret_cast<char*>(&prefix_), sizeof(prefix_type));
+    else
+      return boost::asio::buffer(data_);
+  }
+
+  // Post: No effect if there is no next chunk.
+  // Throw boost::system::system_error if the size is not a multiple of sizeof(T).
+  void next_chunk()
+  {
+    if(status_ == PREFIX_CHUNK)
+    {
+      std::size_t bytes = ntoh(prefix_);
+      if(bytes % sizeof(T) != 0)
+      {
+        throw boost::system::system_error(error::make_error_code(error::malformed_prefix));
+      }
+      data_.resize(bytes / sizeof(T));
+      status_ = DATA_CHUNK;
+    }
+  }
+
+  void reset()
+  {
+    status_ = PREFIX_CHUNK;
+    prefix_ = 0;
+    converted_ = false;
+  }
+
+  data_type& data()
+  {
+    if(!converted_)
+    {
+      mntoh_array(data_.data(), data_.size());
+      converted_ = true;
+    }
+    return data_;
+  }
+
+ private:
+  status status_;
+  prefix_type prefix_;
+  data_type data_;
+  bool converted_;
+};
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_VECTOR_BUFFER_HPP
@@ -0,0 +1,120 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file CRC32C (Castagnoli) checksum.
+* On x86 with GCC or Clang, the SSE4.2 crc32 instruction is used when the CPU
+* supports it, otherwise a table-driven implementation.
+*/
+
+#ifndef NEEV_CRC32C_HPP
+#define NEEV_CRC32C_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NEEV_CRC32C_X86
+#include <immintrin.h>
+#endif
+
+namespace neev{
+namespace detail{
+
+  using crc32c_kernel = std::uint32_t (*)(std::uint32_t, const unsigned char*, std::size_t);
+
+  // Reflected Castagnoli polynomial.
+  constexpr std::uint32_t crc32c_polynomial = 0x82F63B78;
+
+  inline const std::array<std::uint32_t, 256>& crc32c_table()
+  {
+    static const std::array<std::uint32_t, 256> table = []()
+    {
+      std::array<std::uint32_t, 256> t;
+      for(std::uint32_t i = 0; i < 256; ++i)
+      {
+        std::uint32_t crc = i;
+        for(int bit = 0; bit < 8; ++bit)
+        {
+          crc = (crc >> 1) ^ ((crc & 1) ? crc32c_polynomial : 0);
+        }
+        t[i] = crc;
+      }
+      return t;
+    }();
+    return table;
+  }
+
+  inline std::uint32_t crc32c_table_kernel(std::uint32_t crc, const unsigned char* data, std::size_t size)
+  {
+    const std::array<std::uint32_t, 256>& table = crc32c_table();
+    for(std::size_t i = 0; i < size; ++i)
+    {
+      crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+  }
+
+#ifdef NEEV_CRC32C_X86
+
+  __attribute__((target("sse4.2")))
+  inline std::uint32_t crc32c_sse42_kernel(std::uint32_t crc, const unsigned char* data, std::size_t size)
+  {
+#if defined(__x86_64__)
+    std::uint64_t crc64 = crc;
+    for(; size >= 8; size -= 8, data += 8)
+    {
+      std::uint64_t word;
+      std::memcpy(&word, data, 8);
+      crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<std::uint32_t>(crc64);
+#endif
+    for(; size >= 4; size -= 4, data += 4)
+    {
+      std::uint32_t word;
+      std::memcpy(&word, data, 4);
+      crc = _mm_crc32_u32(crc, word);
+    }
+    for(; size > 0; --size, ++data)
+    {
+      crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+  }
+
+  inline crc32c_kernel select_crc32c_kernel()
+  {
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse4.2"))
+      return &crc32c_sse42_kernel;
+    else
+      return &crc32c_table_kernel;
+  }
+
+#else
+
+  inline crc32c_kernel select_crc32c_kernel()
+  {
+    return &crc32c_table_kernel;
+  }
+
+#endif // NEEV_CRC32C_X86
+} // namespace detail
+
+/** Extend the CRC32C crc of the previous bytes with size bytes.
+* The CRC32C of a whole buffer is crc32c(0, data, size).
+*/
+inline std::uint32_t crc32c(std::uint32_t crc, const void* data, std::size_t size)
+{
+  // The kernel is selected once, the first time it is needed.
+  static const detail::crc32c_kernel kernel = detail::select_crc32c_kernel();
+  return ~kernel(~crc, static_cast<const unsigned char*>(data), size);
+}
+
+} // namespace neev
+
+#endif // NEEV_CRC32C_HPP
@@ -0,0 +1,161 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Reverse the bytes of every element of an array of 2, 4 or 8 bytes elements.
+* On x86 with GCC or Clang, the SSSE3 or AVX2 kernel is selected at runtime
+* depending on the CPU, otherwise a scalar loop is used.
+*/
+
+#ifndef NEEV_DETAIL_BULK_BYTESWAP_HPP
+#define NEEV_DETAIL_BULK_BYTESWAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NEEV_BULK_BYTESWAP_X86
+#include <immintrin.h>
+#endif
+
+namespace neev{
+namespace detail{
+
+  template <std::size_t Size>
+  struct byteswap_uint;
+
+  template <>
+  struct byteswap_uint<2>
+  {
+    using type = std::uint16_t;
+    static type reverse(type v)
+    {
+      return static_cast<type>((v >> 8) | (v << 8));
+    }
+  };
+
+  template <>
+  struct byteswap_uint<4>
+  {
+    using type = std::uint32_t;
+    static type reverse(type v)
+    {
+      return ((v & 0x000000ffu) << 24) | ((v & 0x0000ff00u) << 8)
+           | ((v & 0x00ff0000u) >> 8)  | ((v & 0xff000000u) >> 24);
+    }
+  };
+
+  template <>
+  struct byteswap_uint<8>
+  {
+    using type = std::uint64_t;
+    static type reverse(type v)
+    {
+      return (static_cast<type>(byteswap_uint<4>::reverse(static_cast<std::uint32_t>(v))) << 32)
+           | byteswap_uint<4>::reverse(static_cast<std::uint32_t>(v >> 32));
+    }
+  };
+
+  using byteswap_kernel = void (*)(const char*, char*, std::size_t);
+
+  /** Swap n elements of Size bytes from in to out (in can be equal to out).
+  */
+  template <std::size_t Size>
+  void byteswap_scalar(const char* in, char* out, std::size_t n)
+  {
+    using uint = byteswap_uint<Size>;
+    for(std::size_t i = 0; i < n; ++i, in += Size, out += Size)
+    {
+      typename uint::type value;
+      std::memcpy(&value, in, Size);
+      value = uint::reverse(value);
+      std::memcpy(out, &value, Size);
+    }
+  }
+
+#ifdef NEEV_BULK_BYTESWAP_X86
+
+  // Shuffle reversing the bytes of each element of a 16 bytes lane.
+  template <std::size_t Size>
+  __attribute__((target("ssse3")))
+  inline __m128i byteswap_mask()
+  {
+    return Size == 2 ? _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+         : Size == 4 ? _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+         :             _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  }
+
+  template <std::size_t Size>
+  __attribute__((target("ssse3")))
+  void byteswap_ssse3(const char* in, char* out, std::size_t n)
+  {
+    const __m128i mask = byteswap_mask<Size>();
+    const std::size_t per_vector = 16 / Size;
+    std::size_t i = 0;
+    for(; i + per_vector <= n; i += per_vector, in += 16, out += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(v, mask));
+    }
+    byteswap_scalar<Size>(in, out, n - i);
+  }
+
+  template <std::size_t Size>
+  __attribute__((target("avx2")))
+  void byteswap_avx2(const char* in, char* out, std::size_t n)
+  {
+    // _mm256_shuffle_epi8 shuffles each 16 bytes lane independently.
+    const __m256i mask = _mm256_broadcastsi128_si256(byteswap_mask<Size>());
+    const std::size_t per_vector = 32 / Size;
+    std::size_t i = 0;
+    for(; i + 2 * per_vector <= n; i += 2 * per_vector, in += 64, out += 64)
+    {
+      __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+      __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 32));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_shuffle_epi8(v0, mask));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), _mm256_shuffle_epi8(v1, mask));
+    }
+    byteswap_ssse3<Size>(in, out, n - i);
+  }
+
+  template <std::size_t Size>
+  byteswap_kernel select_byteswap_kernel()
+  {
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+      return &byteswap_avx2<Size>;
+    else if(__builtin_cpu_supports("ssse3"))
+      return &byteswap_ssse3<Size>;
+    else
+      return &byteswap_scalar<Size>;
+  }
+
+#else
+
+  template <std::size_t Size>
+  byteswap_kernel select_byteswap_kernel()
+  {
+    return &byteswap_scalar<Size>;
+  }
+
+#endif // NEEV_BULK_BYTESWAP_X86
+
+  /** Swap the bytes of the n elements of Size bytes starting at in, and write
+  * them at out. in and out must either be equal or not overlap.
+  */
+  template <std::size_t Size>
+  void bulk_byteswap(const void* in, void* out, std::size_t n)
+  {
+    static_assert(Size == 2 || Size == 4 || Size == 8,
+      "bulk_byteswap: Only elements of 2, 4 or 8 bytes are supported.");
+    // The kernel is selected once, the first time it is needed.
+    static const byteswap_kernel kernel = select_byteswap_kernel<Size>();
+    kernel(static_cast<const char*>(in), static_cast<char*>(out), n);
+  }
+
+} // namespace detail
+} // namespace neev
+
+#endif // NEEV_DETAIL_BULK_BYTESWAP_HPP
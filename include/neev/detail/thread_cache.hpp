@@ -0,0 +1,89 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Base of the memory caches kept by each thread.
+*/
+
+#ifndef NEEV_DETAIL_THREAD_CACHE_HPP
+#define NEEV_DETAIL_THREAD_CACHE_HPP
+
+#include <new>
+
+namespace neev{
+namespace detail{
+
+  /** One instance of Cache per thread, guarded against its destruction.
+  * The memory held by the other thread_local objects can be released after
+  * the cache is destroyed, it then goes back to the global operator delete.
+  *
+  * Cache derives from thread_cache<Cache>, befriends it, and provides:
+  * - void* allocate(Args...) and void deallocate(void*, Args...),
+  * - static void* allocate_unpooled(Args...), used without a cache.
+  */
+  template <class Cache>
+  class thread_cache
+  {
+  public:
+    /** @return the cache of the calling thread, or nullptr once it is destroyed.
+    */
+    static Cache* local()
+    {
+      if(destroyed())
+      {
+        return nullptr;
+      }
+      static thread_local Cache cache;
+      return &cache;
+    }
+
+    template <class... Args>
+    static void* allocate_local(Args... args)
+    {
+      Cache* cache = local();
+      return cache != nullptr ? cache->allocate(args...) : Cache::allocate_unpooled(args...);
+    }
+
+    template <class... Args>
+    static void deallocate_local(void* block, Args... args)
+    {
+      Cache* cache = local();
+      if(cache != nullptr)
+      {
+        cache->deallocate(block, args...);
+      }
+      else
+      {
+        ::operator delete(block);
+      }
+    }
+
+    thread_cache(thread_cache&&) = delete;
+    thread_cache& operator=(thread_cache&&) = delete;
+    thread_cache(const thread_cache&) = delete;
+    thread_cache& operator=(const thread_cache&) = delete;
+
+  protected:
+    thread_cache() = default;
+
+    // Cache has already released its blocks.
+    ~thread_cache()
+    {
+      destroyed() = true;
+    }
+
+  private:
+    // Trivially destructible, so it is still valid during the destruction
+    // of the other thread_local objects.
+    static bool& destroyed()
+    {
+      static thread_local bool destroyed = false;
+      return destroyed;
+    }
+  };
+
+} // namespace detail
+} // namespace neev
+
+#endif // NEEV_DETAIL_THREAD_CACHE_HPP
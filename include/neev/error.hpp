@@ -0,0 +1,94 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Error codes reported by the neev transfers through transfer_error.
+*/
+
+#ifndef NEEV_ERROR_HPP
+#define NEEV_ERROR_HPP
+
+#include <boost/system/error_code.hpp>
+#include <string>
+
+namespace neev{
+namespace error{
+
+enum transfer_errors
+{
+  /// The size announced by the peer exceeds the limit of the receiver.
+  message_too_large = 1,
+  /// The length prefix received is not well-formed.
+  malformed_prefix,
+  /// The compressed payload can't be decompressed.
+  corrupted_payload,
+  /// The checksum of the message doesn't match its content.
+  checksum_mismatch,
+  /// The message can't be deserialized.
+  invalid_archive,
+  /// The receiver has no memory available for the message.
+  no_buffer_space
+};
+
+namespace detail{
+
+  class transfer_category
+  : public boost::system::error_category
+  {
+  public:
+    const char* name() const BOOST_SYSTEM_NOEXCEPT
+    {
+      return "neev.transfer";
+    }
+
+    std::string message(int value) const
+    {
+      switch(value)
+      {
+        case message_too_large:
+          return "The message is larger than the receiver accepts";
+        case malformed_prefix:
+          return "The length prefix of the message is malformed";
+        case corrupted_payload:
+          return "The compressed payload of the message is corrupted";
+        case checksum_mismatch:
+          return "The checksum of the message doesn't match its content";
+        case invalid_archive:
+          return "The message is not a valid archive";
+        case no_buffer_space:
+          return "No memory is available to receive the message";
+        default:
+          return "neev.transfer error";
+      }
+    }
+  };
+} // namespace detail
+
+inline const boost::system::error_category& get_transfer_category()
+{
+  static detail::transfer_category instance;
+  return instance;
+}
+
+inline boost::system::error_code make_error_code(transfer_errors e)
+{
+  return boost::system::error_code(static_cast<int>(e), get_transfer_category());
+}
+
+} // namespace error
+} // namespace neev
+
+namespace boost{
+namespace system{
+
+template <>
+struct is_error_code_enum<neev::error::transfer_errors>
+{
+  static const bool value = true;
+};
+
+} // namespace system
+} // namespace boost
+
+#endif // NEEV_ERROR_HPP
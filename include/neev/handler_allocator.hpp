@@ -0,0 +1,181 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2003-2013 Christopher M. Kohlhoff (chris at kohlhoff dot com)
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Recycling memory for the completion handlers of asynchronous operations.
+* Adapted from the custom memory allocation example of Boost.Asio.
+*/
+
+#ifndef NEEV_HANDLER_ALLOCATOR_HPP
+#define NEEV_HANDLER_ALLOCATOR_HPP
+
+#include <boost/asio.hpp>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+#include <new>
+
+namespace neev{
+
+/** Default size of a handler_memory block. The operation of a transfer (the
+* read or write operation holding the buffers, the completion condition and
+* the handler, each bound to a shared_ptr) takes about 250 to 300 bytes on a
+* 64-bit platform, the rest is left for larger wrappers of the handler.
+*/
+constexpr std::size_t default_handler_memory_size = 512;
+
+/** Block of memory reused by successive asynchronous operations.
+* A network_transfer never has more than one operation pending at a time
+* and Asio releases the memory of an operation before calling its handler,
+* so a single block is enough. Requests larger than the block, or made while
+* the block is in use, fall back to the global operator new.
+*/
+template <std::size_t Size = default_handler_memory_size>
+class handler_memory
+{
+public:
+  handler_memory()
+  : in_use_(false)
+  {}
+
+  handler_memory(handler_memory&&) = delete;
+  handler_memory& operator=(handler_memory&&) = delete;
+  handler_memory(const handler_memory&) = delete;
+  handler_memory& operator=(const handler_memory&) = delete;
+
+  void* allocate(std::size_t size)
+  {
+    if(!in_use_ && size <= sizeof(storage_))
+    {
+      in_use_ = true;
+      return &storage_;
+    }
+    return ::operator new(size);
+  }
+
+  void deallocate(void* pointer)
+  {
+    if(pointer == &storage_)
+    {
+      in_use_ = false;
+    }
+    else
+    {
+      ::operator delete(pointer);
+    }
+  }
+
+private:
+  typename std::aligned_storage<Size>::type storage_;
+  bool in_use_;
+};
+
+/** Standard allocator interface over a handler_memory, used by Asio versions
+* relying on the associated allocator of a handler instead of the hooks.
+*/
+template <class T, std::size_t Size = default_handler_memory_size>
+class handler_allocator
+{
+public:
+  using value_type = T;
+
+  template <class U>
+  struct rebind
+  {
+    using other = handler_allocator<U, Size>;
+  };
+
+  explicit handler_allocator(handler_memory<Size>& memory)
+  : memory_(&memory)
+  {}
+
+  template <class U>
+  handler_allocator(const handler_allocator<U, Size>& other)
+  : memory_(other.memory_)
+  {}
+
+  T* allocate(std::size_t n) const
+  {
+    return static_cast<T*>(memory_->allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T* p, std::size_t) const
+  {
+    memory_->deallocate(p);
+  }
+
+  template <class U>
+  bool operator==(const handler_allocator<U, Size>& other) const
+  {
+    return memory_ == other.memory_;
+  }
+
+  template <class U>
+  bool operator!=(const handler_allocator<U, Size>& other) const
+  {
+    return memory_ != other.memory_;
+  }
+
+private:
+  template <class, std::size_t> friend class handler_allocator;
+
+  handler_memory<Size>* memory_;
+};
+
+/** Wrap a handler so that the operations it completes are allocated
+* from a handler_memory.
+* @note The memory must outlive the handler, it is usually owned by the
+* object the handler keeps alive.
+*/
+template <class Handler, std::size_t Size = default_handler_memory_size>
+class custom_alloc_handler
+{
+public:
+  using allocator_type = handler_allocator<void, Size>;
+
+  custom_alloc_handler(handler_memory<Size>& memory, Handler handler)
+  : memory_(&memory)
+  , handler_(std::move(handler))
+  {}
+
+  allocator_type get_allocator() const
+  {
+    return allocator_type(*memory_);
+  }
+
+  template <class... Args>
+  void operator()(Args&&... args)
+  {
+    handler_(std::forward<Args>(args)...);
+  }
+
+  friend void* asio_handler_allocate(std::size_t size,
+    custom_alloc_handler<Handler, Size>* this_handler)
+  {
+    return this_handler->memory_->allocate(size);
+  }
+
+  friend void asio_handler_deallocate(void* pointer, std::size_t /*size*/,
+    custom_alloc_handler<Handler, Size>* this_handler)
+  {
+    this_handler->memory_->deallocate(pointer);
+  }
+
+private:
+  handler_memory<Size>* memory_;
+  Handler handler_;
+};
+
+template <class Handler, std::size_t Size>
+custom_alloc_handler<typename std::decay<Handler>::type, Size>
+make_custom_alloc_handler(handler_memory<Size>& memory, Handler&& handler)
+{
+  return custom_alloc_handler<typename std::decay<Handler>::type, Size>(
+    memory, std::forward<Handler>(handler));
+}
+
+} // namespace neev
+
+#endif // NEEV_HANDLER_ALLOCATOR_HPP
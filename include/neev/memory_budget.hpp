@@ -0,0 +1,323 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Accounting of the memory held by the received messages.
+*/
+
+#ifndef NEEV_MEMORY_BUDGET_HPP
+#define NEEV_MEMORY_BUDGET_HPP
+
+#include <boost/assert.hpp>
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace neev{
+
+class memory_account;
+
+/** Process-wide amount of memory the received messages can use.
+*
+* The budget has three limits: the size of a single message, the memory
+* held by a single connection (memory_account) and the memory held by all
+* the connections together. A message larger than one of the limits is
+* rejected. A message that only doesn't fit yet waits for the memory to come
+* back; the waiting requests are served in order.
+*
+* A budget is usually shared by all the connections of a server, all its
+* methods can be called concurrently.
+*/
+class memory_budget
+{
+public:
+  using resume_handler = std::function<void()>;
+
+  memory_budget(std::size_t global_limit, std::size_t connection_limit, std::size_t message_limit)
+  : global_limit_(global_limit)
+  , connection_limit_(connection_limit)
+  , message_limit_(message_limit)
+  , used_(0)
+  {}
+
+  memory_budget(memory_budget&&) = delete;
+  memory_budget& operator=(memory_budget&&) = delete;
+  memory_budget(const memory_budget&) = delete;
+  memory_budget& operator=(const memory_budget&) = delete;
+
+  std::size_t global_limit() const { return global_limit_; }
+  std::size_t connection_limit() const { return connection_limit_; }
+  std::size_t message_limit() const { return message_limit_; }
+
+  /** @return the size of the largest message that can ever be accepted.
+  */
+  std::size_t max_message_size() const
+  {
+    return std::min(message_limit_, std::min(connection_limit_, global_limit_));
+  }
+
+  /** @return the memory held by all the connections.
+  */
+  std::size_t used() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return used_;
+  }
+
+  /** @return the number of requests waiting for memory.
+  */
+  std::size_t waiting() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return waiting_.size();
+  }
+
+private:
+  friend class memory_account;
+
+  struct waiter
+  {
+    std::shared_ptr<memory_account> account;
+    std::size_t size;
+    resume_handler resume;
+  };
+
+  // Defined after memory_account.
+  bool acquire(const std::shared_ptr<memory_account>& account, std::size_t size, resume_handler&& resume);
+  void release(memory_account& account, std::size_t size);
+  bool withdraw(memory_account& account);
+  bool fits_connection(const memory_account& account, std::size_t size) const;
+  void serve(std::vector<resume_handler>& resumed);
+
+  bool fits_global(std::size_t size) const
+  {
+    return used_ + size <= global_limit_;
+  }
+
+  std::size_t global_limit_;
+  std::size_t connection_limit_;
+  std::size_t message_limit_;
+
+  mutable std::mutex mutex_;
+  std::size_t used_;
+  std::list<waiter> waiting_;
+};
+
+/** Memory held by a single connection, charged to a memory_budget.
+*/
+class memory_account
+: public std::enable_shared_from_this<memory_account>
+{
+public:
+  using resume_handler = memory_budget::resume_handler;
+
+  explicit memory_account(const std::shared_ptr<memory_budget>& budget)
+  : budget_(budget)
+  , used_(0)
+  {
+    BOOST_ASSERT_MSG(static_cast<bool>(budget),
+      "Cannot construct a memory_account object with an uninitialized budget.");
+  }
+
+  memory_account(memory_account&&) = delete;
+  memory_account& operator=(memory_account&&) = delete;
+  memory_account(const memory_account&) = delete;
+  memory_account& operator=(const memory_account&) = delete;
+
+  memory_budget& budget() const { return *budget_; }
+
+  std::size_t used() const
+  {
+    std::lock_guard<std::mutex> lock(budget_->mutex_);
+    return used_;
+  }
+
+  /** Reserve size bytes.
+  * @return true if the memory is reserved, otherwise false and resume is
+  * called, from the thread releasing the memory, once it is reserved.
+  * @pre size <= budget().max_message_size().
+  */
+  bool acquire(std::size_t size, resume_handler resume)
+  {
+    BOOST_ASSERT_MSG(size <= budget_->max_message_size(),
+      "memory_account::acquire: The request can never be satisfied.");
+    return budget_->acquire(shared_from_this(), size, std::move(resume));
+  }
+
+  /** Give back size bytes previously reserved.
+  */
+  void release(std::size_t size)
+  {
+    budget_->release(*this, size);
+  }
+
+  /** Remove the request of this account waiting for memory, if any.
+  * @return true if a request was removed, its resume handler is never called.
+  * Otherwise, the memory may already be reserved and resume called.
+  */
+  bool withdraw()
+  {
+    return budget_->withdraw(*this);
+  }
+
+private:
+  friend class memory_budget;
+
+  std::shared_ptr<memory_budget> budget_;
+  // Protected by the mutex of the budget.
+  std::size_t used_;
+};
+
+inline bool memory_budget::fits_connection(const memory_account& account, std::size_t size) const
+{
+  return account.used_ + size <= connection_limit_;
+}
+
+inline bool memory_budget::acquire(const std::shared_ptr<memory_account>& account,
+  std::size_t size, resume_handler&& resume)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  // A request waiting for the global budget has the priority. The requests
+  // waiting for their own connection to release memory don't block the others.
+  bool global_waiter = std::any_of(waiting_.begin(), waiting_.end(),
+    [this](const waiter& w){ return fits_connection(*w.account, w.size); });
+  if(!global_waiter && fits_global(size) && fits_connection(*account, size))
+  {
+    used_ += size;
+    account->used_ += size;
+    return true;
+  }
+  waiting_.push_back(waiter{account, size, std::move(resume)});
+  return false;
+}
+
+inline void memory_budget::release(memory_account& account, std::size_t size)
+{
+  std::vector<resume_handler> resumed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    BOOST_ASSERT_MSG(account.used_ >= size && used_ >= size,
+      "memory_budget::release: More memory released than reserved.");
+    used_ -= size;
+    account.used_ -= size;
+    serve(resumed);
+  }
+  for(resume_handler& resume : resumed)
+  {
+    resume();
+  }
+}
+
+inline bool memory_budget::withdraw(memory_account& account)
+{
+  std::vector<resume_handler> resumed;
+  // Destroyed once unlocked, its resume handler may own the last reference to a transfer.
+  std::list<waiter> withdrawn;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto w = std::find_if(waiting_.begin(), waiting_.end(),
+      [&account](const waiter& w){ return w.account.get() == &account; });
+    if(w != waiting_.end())
+    {
+      withdrawn.splice(withdrawn.end(), waiting_, w);
+      // The request removed may have been blocking the next ones.
+      serve(resumed);
+    }
+  }
+  for(resume_handler& resume : resumed)
+  {
+    resume();
+  }
+  return !withdrawn.empty();
+}
+
+// Pre: mutex_ is locked.
+inline void memory_budget::serve(std::vector<resume_handler>& resumed)
+{
+  for(auto w = waiting_.begin(); w != waiting_.end(); )
+  {
+    if(!fits_connection(*w->account, w->size))
+    {
+      ++w;
+    }
+    else if(!fits_global(w->size))
+    {
+      break;
+    }
+    else
+    {
+      used_ += w->size;
+      w->account->used_ += w->size;
+      resumed.push_back(std::move(w->resume));
+      w = waiting_.erase(w);
+    }
+  }
+}
+
+/** Memory reserved in a memory_account, given back on destruction.
+*/
+class memory_reservation
+{
+public:
+  memory_reservation()
+  : size_(0)
+  {}
+
+  /** Take the ownership of size bytes already acquired in account.
+  */
+  memory_reservation(const std::shared_ptr<memory_account>& account, std::size_t size)
+  : account_(account)
+  , size_(size)
+  {}
+
+  memory_reservation(memory_reservation&& other)
+  : account_(std::move(other.account_))
+  , size_(other.size_)
+  {
+    other.size_ = 0;
+  }
+
+  memory_reservation& operator=(memory_reservation&& other)
+  {
+    if(this != &other)
+    {
+      release();
+      account_ = std::move(other.account_);
+      size_ = other.size_;
+      other.size_ = 0;
+    }
+    return *this;
+  }
+
+  memory_reservation(const memory_reservation&) = delete;
+  memory_reservation& operator=(const memory_reservation&) = delete;
+
+  ~memory_reservation()
+  {
+    release();
+  }
+
+  std::size_t size() const { return size_; }
+
+  void release()
+  {
+    if(account_)
+    {
+      account_->release(size_);
+      account_.reset();
+      size_ = 0;
+    }
+  }
+
+private:
+  std::shared_ptr<memory_account> account_;
+  std::size_t size_;
+};
+
+} // namespace neev
+
+#endif // NEEV_MEMORY_BUDGET_HPP
@@ -6,7 +6,11 @@
 #ifndef NEEV_NETWORK_CONVERTER_HPP
 #define NEEV_NETWORK_CONVERTER_HPP
 
+#include <neev/detail/bulk_byteswap.hpp>
 #include <boost/endian/conversion.hpp>
+#include <boost/predef/other/endian.h>
+#include <cstring>
+#include <type_traits>
 
 namespace neev{
 
@@ -36,6 +40,55 @@ T ntoh(T value)
   return boost::endian::betoh(value);
 }
 
+// Conversion of the n elements of an array, integers or floating point numbers
+// of 2, 4 or 8 bytes, in a single pass (SIMD when available).
+// The network byte order is big endian, so it is a no-op on big endian hosts.
+
+namespace detail{
+
+  template <class T>
+  void convert_array(const T* in, T* out, std::size_t n)
+  {
+    static_assert(std::is_arithmetic<T>::value,
+      "Only arrays of integers or floating point numbers can be converted.");
+#if BOOST_ENDIAN_BIG_BYTE
+    if(in != out)
+    {
+      std::memcpy(out, in, n * sizeof(T));
+    }
+#else
+    detail::bulk_byteswap<sizeof(T)>(in, out, n);
+#endif
+  }
+} // namespace detail
+
+template <class T>
+void mhton_array(T* data, std::size_t n)
+{
+  detail::convert_array(data, data, n);
+}
+
+/** Convert the n elements of in to network byte order in out.
+* in and out must either be equal or not overlap.
+*/
+template <class T>
+void hton_array(const T* in, T* out, std::size_t n)
+{
+  detail::convert_array(in, out, n);
+}
+
+template <class T>
+void mntoh_array(T* data, std::size_t n)
+{
+  detail::convert_array(data, data, n);
+}
+
+template <class T>
+void ntoh_array(const T* in, T* out, std::size_t n)
+{
+  detail::convert_array(in, out, n);
+}
+
 } // namespace neev
 
 #endif // NEEV_NETWORK_CONVERTER_HPP
\ No newline at end of file
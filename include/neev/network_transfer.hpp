@@ -15,9 +15,12 @@
 #include <neev/transfer_events.hpp>
 #include <neev/transfer_operation.hpp>
 #include <neev/timer_policy.hpp>
+#include <neev/handler_allocator.hpp>
+#include <neev/traits/buffer_provider_traits.hpp>
 #include <boost/asio.hpp>
 #include <boost/assert.hpp>
 #include <memory>
+#include <atomic>
 
 namespace neev{
 namespace detail{
@@ -57,6 +60,9 @@ public:
   using transfer_category = typename BufferProvider::transfer_category;
   using this_type = network_transfer<provider_type, observer_type, socket_type, timer_policy>;
 
+  // The timer policy reaches the transfer through its private base.
+  friend timer_policy;
+
   template <class ObserverType, class... BufferProviderArgs>
   network_transfer(const socket_ptr& socket, ObserverType&& observer, BufferProviderArgs&&... args)
   : timer_policy(socket->get_io_service())
@@ -64,6 +70,8 @@ public:
   , observer_(std::forward<ObserverType>(observer))
   , buffer_provider_(std::forward<BufferProviderArgs>(args)...)
   , bytes_transferred_(0)
+  , receive_loop_(false)
+  , cancelled_(false)
   {
     BOOST_ASSERT_MSG(static_cast<bool>(socket), 
       "Cannot construct a network_transfer object with an uninitialized socket_ptr.");
@@ -83,6 +91,13 @@ public:
   const data_type& data() const { return buffer_provider_.data(); }
   data_type& data() { return buffer_provider_.data(); }
 
+  /** The buffer provider, for the methods specific to it
+  * (such as delimited_receive_buffer::take_leftover()).
+  * It must not be modified while an operation is in progress.
+  */
+  const provider_type& buffer_provider() const { return buffer_provider_; }
+  provider_type& buffer_provider() { return buffer_provider_; }
+
   /** Start an asynchronous transfer of data.
   */
   void async_transfer()
@@ -105,23 +120,71 @@ public:
     }
   }
 
+  /** Start an asynchronous receive launched again each time a message
+  * has been received and transfer_complete has been dispatched.
+  * The storage of the buffer provider is kept from one message to the next.
+  * The loop stops on the first error or when cancel() is called.
+  * @note The buffer provider must provide a reset() method.
+  */
+  void async_receive_loop()
+  {
+    static_assert(boost::is_same<transfer_category, receive_op>::value,
+      "async_receive_loop() is only available for receive operations.");
+    static_assert(has_reset<provider_type>::value,
+      "async_receive_loop() needs a buffer provider with a reset() method.");
+    receive_loop_ = true;
+    async_transfer_impl();
+  }
+
+  /** Cancel the operation in progress, transfer_error is dispatched.
+  * A transfer paused by its buffer provider is withdrawn from what it waits for.
+  * It can be called from any thread: the socket is cancelled by a handler
+  * posted through the timer policy, and no new operation is started once
+  * it is called. error is cleared.
+  */
   void cancel(boost::system::error_code &error)
   {
-    socket_->cancel(error);
+    error = boost::system::error_code();
+    receive_loop_ = false;
+    cancelled_ = true;
+    post(std::bind(&this_type::cancel_socket, this->shared_from_this()));
+    cancel_wait(has_wait_next_chunk<provider_type>());
   }
 
 private:
+  // The handlers posted by the transfer are serialized with its completion
+  // handlers as the timer policy does.
+  template <class Handler>
+  void post(Handler handler)
+  {
+    timer_policy::post(socket_->get_io_service(), handler);
+  }
+
+  void cancel_socket()
+  {
+    boost::system::error_code ignore;
+    socket_->cancel(ignore);
+  }
+
   void async_transfer_impl()
   {
     using std::placeholders::_1;
     using std::placeholders::_2;
 
+    // cancel() may have been called after the last operation completed,
+    // when there was nothing for the socket to cancel.
+    if(cancelled_)
+    {
+      on_cancelled();
+      return;
+    }
+    // The completion condition is invoked by the composed operation in the
+    // context of the completion handler, it must not be wrapped.
     transfer<transfer_category>::async_transfer(*socket_
     , buffer_provider_.chunk()
-    , timer_policy::wrap(std::bind(&this_type::is_transfer_complete, 
-        this->shared_from_this(), _1, _2))
-    , timer_policy::wrap(std::bind(&this_type::on_chunk_complete, 
-        this->shared_from_this(), _1, _2))
+    , std::bind(&this_type::is_transfer_complete, this->shared_from_this(), _1, _2)
+    , timer_policy::wrap(make_custom_alloc_handler(handler_memory_,
+        std::bind(&this_type::on_chunk_complete, this->shared_from_this(), _1, _2)))
     );
   }
 
@@ -157,7 +220,7 @@ private:
     }
     else if(error)
     {
-      dispatch_event<transfer_error>(detail::deref(observer_), error);
+      fail(error);
     }
     else
     {
@@ -167,9 +230,20 @@ private:
         // Could it be replaced by "is_done" ?
         if(!buffer_provider_.has_next_chunk())
         {
+          boost::system::error_code verify_error = verify(has_verify<provider_type>());
+          if(verify_error)
+          {
+            fail(verify_error);
+            return;
+          }
+          this->disarm();
           dispatch_event<transfer_complete>(detail::deref(observer_), buffer_provider_.data(), transfer_category());
+          if(receive_loop_)
+          {
+            restart(has_reset<provider_type>());
+          }
         }
-        else
+        else if(wait_next_chunk(has_wait_next_chunk<provider_type>()))
         {
           buffer_provider_.next_chunk();
           async_transfer_impl();
@@ -177,15 +251,115 @@ private:
       }
       catch(const boost::system::system_error& e)
       {
-        dispatch_event<transfer_error>(detail::deref(observer_), e.code());
+        fail(e.code());
       }
     }
   }
 
+  // The timeout is already expired when the transfer fails because of it.
+  void fail(const boost::system::error_code& error)
+  {
+    this->disarm();
+    dispatch_event<transfer_error>(detail::deref(observer_), error);
+  }
+
+  boost::system::error_code verify(std::false_type)
+  {
+    return boost::system::error_code();
+  }
+
+  boost::system::error_code verify(std::true_type)
+  {
+    return buffer_provider_.verify();
+  }
+
+  bool wait_next_chunk(std::false_type)
+  {
+    return true;
+  }
+
+  void cancel_wait(std::false_type) {}
+
+  // No operation is pending while the transfer is paused, the error is
+  // dispatched here unless resume was already called (see on_resume).
+  void cancel_wait(std::true_type)
+  {
+    if(buffer_provider_.cancel_wait())
+    {
+      post(std::bind(&this_type::on_cancelled, this->shared_from_this()));
+    }
+  }
+
+  /** Ask the buffer provider if the next chunk can be transferred now,
+  * otherwise the transfer is paused until on_resume() is called.
+  */
+  bool wait_next_chunk(std::true_type)
+  {
+    auto self = this->shared_from_this();
+    if(buffer_provider_.wait_next_chunk([self]()
+      {
+        self->post(std::bind(&this_type::on_resume, self));
+      }))
+    {
+      return true;
+    }
+    dispatch_event<transfer_paused>(detail::deref(observer_));
+    // cancel() may have missed the request queued by the provider.
+    if(cancelled_)
+    {
+      cancel_wait(std::true_type());
+    }
+    return false;
+  }
+
+  void on_resume()
+  {
+    if(cancelled_)
+    {
+      buffer_provider_.abandon();
+      on_cancelled();
+      return;
+    }
+    dispatch_event<transfer_resumed>(detail::deref(observer_));
+    try
+    {
+      buffer_provider_.next_chunk();
+      async_transfer_impl();
+    }
+    catch(const boost::system::system_error& e)
+    {
+      fail(e.code());
+    }
+  }
+
+  void on_cancelled()
+  {
+    fail(boost::asio::error::make_error_code(this->is_timed_out()
+      ? boost::asio::error::timed_out
+      : boost::asio::error::operation_aborted));
+  }
+
+  void restart(std::true_type)
+  {
+    buffer_provider_.reset();
+    bytes_transferred_ = 0;
+    async_transfer_impl();
+  }
+
+  // Only reached with async_receive_loop(), which rejects these providers.
+  void restart(std::false_type) {}
+
   socket_ptr socket_;
   observer_type observer_;
   provider_type buffer_provider_;
   std::size_t bytes_transferred_;
+  // cancel() may be called from another thread than the completion handlers.
+  std::atomic<bool> receive_loop_;
+  std::atomic<bool> cancelled_;
+
+  // The operations launched for each chunk are allocated in this block,
+  // the transfer doesn't allocate memory for its handlers after the first chunk.
+  handler_memory<> handler_memory_;
 };
 
 template <class BufferTraits, class TimerPolicy = no_timer, class Socket, class Observer, class... BufferArgs>
@@ -0,0 +1,167 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Receive a stream of prefixed frames with as few reads as possible.
+*/
+
+#ifndef NEEV_READAHEAD_RECEIVER_HPP
+#define NEEV_READAHEAD_RECEIVER_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/buffer/readahead_buffer.hpp>
+#include <neev/handler_allocator.hpp>
+#include <boost/asio.hpp>
+#include <boost/assert.hpp>
+#include <boost/system/system_error.hpp>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+
+namespace neev{
+
+/** Receive prefixed frames continuously from a socket.
+*
+* Unlike a network_transfer over a prefixed_receive_buffer, that reads the
+* prefix and the data of each frame with two exact-size reads, this receiver
+* issues large async_read_some calls and delivers every complete frame read
+* to the observer (transfer_complete event). The bytes of a partial frame
+* are kept for the next read.
+*
+* The receiver stops on the first error (transfer_error event), a frame
+* larger than max_size failing with error::message_too_large, or
+* when cancel() is called.
+*/
+template <class PrefixType, class Observer, class Socket>
+class readahead_receiver
+: public std::enable_shared_from_this<readahead_receiver<PrefixType, Observer, Socket>>
+{
+public:
+  using socket_type = Socket;
+  using socket_ptr = std::shared_ptr<socket_type>;
+  using buffer_type = readahead_receive_buffer<PrefixType>;
+  using data_type = typename buffer_type::data_type;
+  using prefix_type = PrefixType;
+  using observer_type = Observer;
+  using transfer_category = receive_op;
+  using this_type = readahead_receiver<prefix_type, observer_type, socket_type>;
+
+  /**
+  * @param read_size is the minimal space given to each read, it should
+  * be large enough to hold several frames.
+  * @param max_size is the largest payload accepted.
+  */
+  template <class ObserverType>
+  readahead_receiver(const socket_ptr& socket, ObserverType&& observer, std::size_t read_size = 4096,
+    std::size_t max_size = std::numeric_limits<std::size_t>::max())
+  : socket_(socket)
+  , observer_(std::forward<ObserverType>(observer))
+  , buffer_(read_size, max_size)
+  , frame_()
+  , running_(false)
+  {
+    BOOST_ASSERT_MSG(static_cast<bool>(socket),
+      "Cannot construct a readahead_receiver object with an uninitialized socket_ptr.");
+  }
+
+  readahead_receiver(readahead_receiver&&) = delete;
+  readahead_receiver& operator=(readahead_receiver&&) = delete;
+  readahead_receiver(const readahead_receiver&) = delete;
+  readahead_receiver& operator=(const readahead_receiver&) = delete;
+
+  /** Start receiving the frames.
+  */
+  void async_receive()
+  {
+    running_ = true;
+    async_read_some();
+  }
+
+  /** Stop receiving, it can be called from any thread: the socket is
+  * cancelled by a handler posted to its io_service, and no read is started
+  * once it is called. error is cleared.
+  */
+  void cancel(boost::system::error_code &error)
+  {
+    error = boost::system::error_code();
+    running_ = false;
+    socket_->get_io_service().post(std::bind(&this_type::cancel_socket, this->shared_from_this()));
+  }
+
+private:
+  void cancel_socket()
+  {
+    boost::system::error_code ignore;
+    socket_->cancel(ignore);
+  }
+
+  void async_read_some()
+  {
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+
+    socket_->async_read_some(buffer_.prepare(),
+      make_custom_alloc_handler(handler_memory_,
+        std::bind(&this_type::on_read, this->shared_from_this(), _1, _2)));
+  }
+
+  void on_read(const boost::system::error_code& error, std::size_t bytes_transferred)
+  {
+    if(error)
+    {
+      running_ = false;
+      dispatch_event<transfer_error>(detail::deref(observer_), error);
+    }
+    else
+    {
+      buffer_.commit(bytes_transferred);
+      try
+      {
+        while(running_ && buffer_.next_frame(frame_))
+        {
+          dispatch_event<transfer_complete>(detail::deref(observer_), frame_, transfer_category());
+        }
+        if(running_)
+        {
+          async_read_some();
+        }
+      }
+      catch(const boost::system::system_error& e)
+      {
+        running_ = false;
+        dispatch_event<transfer_error>(detail::deref(observer_), e.code());
+      }
+    }
+  }
+
+  socket_ptr socket_;
+  observer_type observer_;
+  buffer_type buffer_;
+  data_type frame_;
+  std::atomic<bool> running_;
+  handler_memory<> handler_memory_;
+};
+
+template <class PrefixType, class Socket, class Observer>
+std::shared_ptr<readahead_receiver<PrefixType, Observer, Socket>>
+make_readahead_receiver(const std::shared_ptr<Socket>& socket, Observer&& observer, std::size_t read_size = 4096,
+  std::size_t max_size = std::numeric_limits<std::size_t>::max())
+{
+  return std::make_shared<readahead_receiver<PrefixType, Observer, Socket>>(
+    socket, std::forward<Observer>(observer), read_size, max_size);
+}
+
+template <class PrefixType, class Socket, class Observer>
+std::shared_ptr<readahead_receiver<PrefixType, Observer&, Socket>>
+make_readahead_receiver(const std::shared_ptr<Socket>& socket, std::reference_wrapper<Observer> observer, std::size_t read_size = 4096,
+  std::size_t max_size = std::numeric_limits<std::size_t>::max())
+{
+  return std::make_shared<readahead_receiver<PrefixType, Observer&, Socket>>(
+    socket, observer.get(), read_size, max_size);
+}
+
+} // namespace neev
+
+#endif // NEEV_READAHEAD_RECEIVER_HPP
@@ -0,0 +1,222 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Ordered and coalesced sending of prefixed frames on a socket.
+*/
+
+#ifndef NEEV_SEND_QUEUE_HPP
+#define NEEV_SEND_QUEUE_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/network_converter.hpp>
+#include <neev/handler_allocator.hpp>
+#include <boost/asio.hpp>
+#include <boost/assert.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace neev{
+
+/** Outbound queue of prefixed frames attached to a single socket.
+*
+* At most one write is pending on the socket. The frames queued while
+* it is in flight are sent together by the next write, as one gathered
+* buffer sequence of at most max_gathered_buffers buffers. The frames are
+* sent in the order they were queued and never interleave.
+*
+* async_send() can be called concurrently from several threads, the writes
+* are always initiated from the io_service of the socket.
+*
+* \par Events
+* - transfer_complete (once per frame sent, with the frame data)
+* - transfer_error, followed by transfer_dropped for every frame of the failed
+*   write and every frame queued behind it
+*/
+template <class PrefixType, class Observer, class Socket>
+class send_queue
+: public std::enable_shared_from_this<send_queue<PrefixType, Observer, Socket>>
+{
+public:
+  using socket_type = Socket;
+  using socket_ptr = std::shared_ptr<socket_type>;
+  using data_type = std::string;
+  using prefix_type = PrefixType;
+  using observer_type = Observer;
+  using transfer_category = send_op;
+  using this_type = send_queue<prefix_type, observer_type, socket_type>;
+
+  static_assert(std::is_unsigned<prefix_type>::value,
+    "The buffer size will never be negative.");
+
+  /// Asio doesn't gather more buffers in a single system call.
+  static constexpr std::size_t max_gathered_buffers = 64;
+
+private:
+  struct frame
+  {
+    frame(data_type&& data)
+    : prefix(hton(static_cast<prefix_type>(data.size())))
+    , data(std::move(data))
+    {}
+
+    prefix_type prefix;
+    data_type data;
+  };
+
+  // Refers to buffers_ instead of copying it in the write operation.
+  struct buffers_ref
+  {
+    using value_type = boost::asio::const_buffer;
+    using const_iterator = std::vector<boost::asio::const_buffer>::const_iterator;
+
+    const_iterator begin() const { return buffers->begin(); }
+    const_iterator end() const { return buffers->end(); }
+
+    const std::vector<boost::asio::const_buffer>* buffers;
+  };
+
+public:
+  template <class ObserverType>
+  send_queue(const socket_ptr& socket, ObserverType&& observer)
+  : socket_(socket)
+  , observer_(std::forward<ObserverType>(observer))
+  , writing_(false)
+  {
+    BOOST_ASSERT_MSG(static_cast<bool>(socket),
+      "Cannot construct a send_queue object with an uninitialized socket_ptr.");
+    in_flight_.reserve(max_gathered_buffers / 2);
+    buffers_.reserve(max_gathered_buffers);
+  }
+
+  send_queue(send_queue&&) = delete;
+  send_queue& operator=(send_queue&&) = delete;
+  send_queue(const send_queue&) = delete;
+  send_queue& operator=(const send_queue&) = delete;
+
+  /** Queue a frame, it is sent as soon as the previous frames are.
+  */
+  void async_send(data_type&& data)
+  {
+    BOOST_ASSERT_MSG(std::numeric_limits<prefix_type>::max() >= data.size(),
+      "send_queue: Try to send data which size is too large "
+      "(choose a larger prefix type).");
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.emplace_back(std::move(data));
+    if(!writing_)
+    {
+      writing_ = true;
+      socket_->get_io_service().post(std::bind(&this_type::write_pending, this->shared_from_this()));
+    }
+  }
+
+  /** @return the number of frames waiting for the current write to finish.
+  */
+  std::size_t pending() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_.size();
+  }
+
+private:
+  // Only one thread at a time runs it: the one owning writing_.
+  void write_pending()
+  {
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+
+    in_flight_.clear();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if(pending_.empty())
+      {
+        writing_ = false;
+        return;
+      }
+      while(!pending_.empty() && 2 * (in_flight_.size() + 1) <= max_gathered_buffers)
+      {
+        in_flight_.push_back(std::move(pending_.front()));
+        pending_.pop_front();
+      }
+    }
+    buffers_.clear();
+    for(const frame& f : in_flight_)
+    {
+      buffers_.push_back(boost::asio::buffer(reinterpret_cast<const char*>(&f.prefix), sizeof(prefix_type)));
+      buffers_.push_back(boost::asio::buffer(f.data));
+    }
+    boost::asio::async_write(*socket_, buffers_ref{&buffers_},
+      make_custom_alloc_handler(handler_memory_,
+        std::bind(&this_type::on_write, this->shared_from_this(), _1, _2)));
+  }
+
+  void on_write(const boost::system::error_code& error, std::size_t)
+  {
+    if(error)
+    {
+      // Once writing_ is released, in_flight_ belongs to the next write.
+      std::vector<frame> dropped;
+      dropped.swap(in_flight_);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::move(pending_.begin(), pending_.end(), std::back_inserter(dropped));
+        pending_.clear();
+        writing_ = false;
+      }
+      dispatch_event<transfer_error>(detail::deref(observer_), error);
+      for(frame& f : dropped)
+      {
+        dispatch_event<transfer_dropped>(detail::deref(observer_), f.data);
+      }
+    }
+    else
+    {
+      for(frame& f : in_flight_)
+      {
+        dispatch_event<transfer_complete>(detail::deref(observer_), f.data, transfer_category());
+      }
+      write_pending();
+    }
+  }
+
+  socket_ptr socket_;
+  observer_type observer_;
+  mutable std::mutex mutex_;
+  std::deque<frame> pending_;
+  std::vector<frame> in_flight_;
+  std::vector<boost::asio::const_buffer> buffers_;
+  bool writing_;
+  // The gather write operation (about 480 bytes) is close to the default block size.
+  handler_memory<1024> handler_memory_;
+};
+
+template <class PrefixType, class Observer, class Socket>
+constexpr std::size_t send_queue<PrefixType, Observer, Socket>::max_gathered_buffers;
+
+template <class PrefixType, class Socket, class Observer>
+std::shared_ptr<send_queue<PrefixType, Observer, Socket>>
+make_send_queue(const std::shared_ptr<Socket>& socket, Observer&& observer)
+{
+  return std::make_shared<send_queue<PrefixType, Observer, Socket>>(
+    socket, std::forward<Observer>(observer));
+}
+
+template <class PrefixType, class Socket, class Observer>
+std::shared_ptr<send_queue<PrefixType, Observer&, Socket>>
+make_send_queue(const std::shared_ptr<Socket>& socket, std::reference_wrapper<Observer> observer)
+{
+  return std::make_shared<send_queue<PrefixType, Observer&, Socket>>(
+    socket, observer.get());
+}
+
+} // namespace neev
+
+#endif // NEEV_SEND_QUEUE_HPP
@@ -11,13 +11,88 @@
 
 #include <neev/server/server_events.hpp>
 #include <boost/asio.hpp>
+#include <boost/assert.hpp>
 #include <string>
 
 namespace neev{
+namespace detail{
+
+  /** Open, bind and listen the acceptor on the first endpoint of the service
+  * that works. The event endpoint_failure is dispatched for each endpoint failing.
+  * configure(acceptor) is called before the acceptor is bound, to set its options.
+  * backlog is the maximum length of the queue of pending connections.
+  *
+  * \return false if no endpoint works, otherwise endpoint is the local endpoint
+  * of the acceptor (with the port chosen by the system for the service "0").
+  */
+  template <class Observer, class Configure>
+  bool listen_on_service(boost::asio::ip::tcp::acceptor& acceptor,
+    const std::string& service, Observer& observer,
+    boost::asio::ip::tcp::endpoint& endpoint, int backlog, Configure configure)
+  {
+    using namespace boost::asio::ip;
+
+    tcp::resolver resolver(acceptor.get_io_service());
+    tcp::resolver::query query(service, tcp::resolver::query::address_configured);
+    tcp::resolver::iterator endpoint_iter = resolver.resolve(query);
+    tcp::resolver::iterator endpoint_end;
+
+    for(; endpoint_iter != endpoint_end; ++endpoint_iter)
+    {
+      try
+      {
+        endpoint = tcp::endpoint(*endpoint_iter);
+        acceptor.open(endpoint.protocol());
+        configure(acceptor);
+        acceptor.bind(endpoint);
+        acceptor.listen(backlog);
+        endpoint = acceptor.local_endpoint();
+        return true;
+      }
+      catch(std::exception &e)
+      {
+        boost::system::error_code ignore;
+        acceptor.close(ignore);
+        dispatch_event<endpoint_failure>(observer, e.what());
+      }
+    }
+    return false;
+  }
+
+  template <class Observer>
+  bool listen_on_service(boost::asio::ip::tcp::acceptor& acceptor,
+    const std::string& service, Observer& observer,
+    boost::asio::ip::tcp::endpoint& endpoint)
+  {
+    return listen_on_service(acceptor, service, observer, endpoint,
+      boost::asio::socket_base::max_connections, [](boost::asio::ip::tcp::acceptor&){});
+  }
+
+  // Index of the server worker running on the calling thread.
+  inline std::size_t& current_worker()
+  {
+    static thread_local std::size_t worker = 0;
+    return worker;
+  }
+} // namespace detail
+
 /** \brief Basic TCP server.
 *
 * Basic TCP server running the io_service.run() method in 
 * a single thread.
+*
+* Several accepts can be kept outstanding (see set_accept_depth()), each one
+* is re-armed before its connection is dispatched. The connections already
+* waiting in the listen queue are then accepted without waiting for the
+* reactor, by batch of at most max_accept_batch.
+*
+* If the observer subscribes to the event new_session, every new client is
+* registered in the session table of the server (see sessions()) and the
+* event is dispatched with its session_id, after new_client. The client goes
+* in the shard of the worker thread accepting it. The table doesn't keep the
+* sockets alive: the application can erase the session when the client
+* disconnects, otherwise the sessions of the destroyed sockets are erased
+* when their shard grows (see session_table::insert with expired_session).
 */
 template <class Observer>
 class basic_server
@@ -31,15 +106,27 @@ public:
 
   using observer_type = Observer;
 
+  using session_table_type = session_table<std::weak_ptr<socket_type>>;
+
+  /// Maximum number of connections accepted at once from the listen queue.
+  static constexpr std::size_t max_accept_batch = 64;
+
 public:
   // Rational: Do not start the server, it could fail and we'd have an invalid object.
   // Also the user would not be able to use the same object to try another service.
+  /**
+  * \param session_shards is the number of shards of the session table.
+  */
   template <class ObserverType>
-  basic_server(ObserverType&& observer)
+  basic_server(ObserverType&& observer, std::size_t session_shards = 1)
   : io_service_()
   , acceptor_(io_service_)
+  , accept_strand_(io_service_)
+  , accept_depth_(1)
+  , listen_backlog_(boost::asio::socket_base::max_connections)
   , server_on_(false)
   , observer_(std::forward<ObserverType>(observer))
+  , sessions_(session_shards)
   {}
 
   basic_server(basic_server&&) = delete;
@@ -47,6 +134,27 @@ public:
   basic_server(const basic_server&) = delete;
   basic_server& operator=(const basic_server&) = delete;
 
+  /** Number of accept operations kept outstanding, 1 by default.
+  * A larger depth absorbs the bursts of connections.
+  *
+  * \pre Must be called before start().
+  */
+  void set_accept_depth(std::size_t depth)
+  {
+    BOOST_ASSERT_MSG(depth > 0, "basic_server::set_accept_depth: The depth can't be 0.");
+    accept_depth_ = depth;
+  }
+
+  /** Maximum length of the queue of the connections waiting to be accepted,
+  * socket_base::max_connections (SOMAXCONN) by default.
+  *
+  * \pre Must be called before start().
+  */
+  void set_listen_backlog(int backlog)
+  {
+    listen_backlog_ = backlog;
+  }
+
   /** Register asynchronous operation to start the server 
   * when run() will be called.
   *
@@ -62,38 +170,19 @@ public:
   */
   void start(const std::string& service)
   {
-    using namespace boost::asio::ip;
-
-    // Find an endpoint on the service specified, if none found, throw a runtime_error exception.
-    tcp::resolver resolver(io_service_);
-    tcp::resolver::query query(service, tcp::resolver::query::address_configured);
-    tcp::resolver::iterator endpoint_iter = resolver.resolve(query);
-    tcp::resolver::iterator endpoint_end;
-    tcp::endpoint endpoint;
-
-    for(; endpoint_iter != endpoint_end; ++endpoint_iter)
-    {
-      try
-      {
-        endpoint = tcp::endpoint(*endpoint_iter);
-        acceptor_.open(endpoint.protocol());
-        acceptor_.bind(endpoint);
-        acceptor_.listen();
-        break;
-      }
-      catch(std::exception &e)
-      {
-        dispatch_event<endpoint_failure>(observer_, e.what());
-      }
-    }
-    if(endpoint_iter == endpoint_end)
+    boost::asio::ip::tcp::endpoint endpoint;
+    if(!detail::listen_on_service(acceptor_, service, observer_, endpoint,
+      listen_backlog_, [](boost::asio::ip::tcp::acceptor&){}))
     {
       dispatch_event<start_failure>(observer_);
     }
     else
     {
       server_on_ = true;
-      start_accept();
+      // The listen queue is drained with synchronous accepts (see drain_listen_queue()).
+      acceptor_.non_blocking(true);
+      for(std::size_t i = 0; i < accept_depth_; ++i)
+        start_accept();
       dispatch_event<start_success>(observer_, endpoint);
     }
   }
@@ -118,21 +207,7 @@ public:
   */
   void run()
   {
-    while(server_on_)
-    {
-      try
-      {
-        io_service_.run();
-      }
-      catch(std::exception& e)
-      {
-        dispatch_event<run_exception>(observer_, e);
-      }
-      catch(...)
-      {
-        dispatch_event<run_unknown_exception>(observer_, std::current_exception());
-      }
-    }
+    run_worker(0);
   }
 
   /** Perform a start and run.
@@ -157,6 +232,15 @@ public:
     return io_service_;
   }
 
+  /**
+  * \return the sessions of the clients, only filled if the observer subscribes
+  * to new_session. It can be used from any thread.
+  */
+  session_table_type& sessions()
+  {
+    return sessions_;
+  }
+
   /** Stop request on the server.
   *
   * \post The server might be not stopped immediately when this function returns.
@@ -169,31 +253,108 @@ public:
     io_service_.stop();
   }
 
+protected:
+  observer_type& get_observer()
+  {
+    return observer_;
+  }
+
+  /** run() on the worker thread of index worker, the clients it accepts
+  * go in the shard worker of the session table (modulo the number of shards).
+  */
+  void run_worker(std::size_t worker)
+  {
+    detail::current_worker() = worker;
+    while(server_on_)
+    {
+      try
+      {
+        io_service_.run();
+      }
+      catch(std::exception& e)
+      {
+        dispatch_event<run_exception>(observer_, e);
+      }
+      catch(...)
+      {
+        dispatch_event<run_unknown_exception>(observer_, std::current_exception());
+      }
+    }
+  }
+
 private:
+  // The accept handlers are in a strand: with server_mt, the acceptor
+  // is never used by two threads at the same time.
   void start_accept()
   {
     using std::placeholders::_1;
     socket_ptr socket = std::make_shared<socket_type>(std::ref(io_service_));
-    acceptor_.async_accept(*socket,
-      std::bind(&basic_server::handle_accept, this, socket, _1)
+    acceptor_.async_accept(*socket, accept_strand_.wrap(
+      std::bind(&basic_server::handle_accept, this, socket, _1))
     );
   }
 
   void handle_accept(const socket_ptr& socket, const boost::system::error_code& e)
   {
+    start_accept();
     if (!e)
     {
-      dispatch_event<new_client>(observer_, socket);
+      post_new_client(socket);
+      drain_listen_queue();
     }
-    start_accept();
+  }
+
+  // Accept the connections already in the listen queue, the acceptor is
+  // non-blocking so it stops as soon as the queue is empty.
+  void drain_listen_queue()
+  {
+    for(std::size_t i = 0; i < max_accept_batch; ++i)
+    {
+      socket_ptr socket = std::make_shared<socket_type>(std::ref(io_service_));
+      boost::system::error_code e;
+      acceptor_.accept(*socket, e);
+      if(e)
+      {
+        break;
+      }
+      post_new_client(socket);
+    }
+  }
+
+  // The event is dispatched outside of the strand, so the observer doesn't
+  // delay the accepts.
+  void post_new_client(const socket_ptr& socket)
+  {
+    io_service_.post(std::bind(&basic_server::dispatch_new_client, this, socket));
+  }
+
+  void dispatch_new_client(const socket_ptr& socket)
+  {
+    dispatch_event<new_client>(observer_, socket);
+    register_session(socket, is_subscribed<observer_type, new_session>());
+  }
+
+  void register_session(const socket_ptr&, std::false_type) {}
+
+  void register_session(const socket_ptr& socket, std::true_type)
+  {
+    session_id id = sessions_.insert(detail::current_worker() % sessions_.shards(), socket, expired_session());
+    dispatch_event<new_session>(observer_, socket, id);
   }
 
   boost::asio::io_service io_service_;
   boost::asio::ip::tcp::acceptor acceptor_;
+  boost::asio::io_service::strand accept_strand_;
+  std::size_t accept_depth_;
+  int listen_backlog_;
   bool server_on_;
   observer_type observer_;
+  session_table_type sessions_;
 };
 
+template <class Observer>
+constexpr std::size_t basic_server<Observer>::max_accept_batch;
+
 } // namespace neev
 
 #endif // NEEV_SERVER_BASIC_SERVER_HPP
@@ -10,9 +10,11 @@
 #define NEEV_SERVER_EVENTS_HPP
 
 #include <neev/traits/observer_traits.hpp>
+#include <neev/server/session_table.hpp>
 #include <boost/asio.hpp>
 #include <boost/system/error_code.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/optional.hpp>
 #include <string>
 #include <exception>
 
@@ -24,6 +26,9 @@ struct start_failure;
 struct run_exception;
 struct run_unknown_exception;
 struct new_client;
+struct shard_new_client;
+struct worker_started;
+struct new_session;
 
 template <class Observer>
 struct event_dispatcher<Observer, endpoint_failure, true>
@@ -80,6 +85,35 @@ struct event_dispatcher<Observer, new_client, true>
   }
 };
 
+template <class Observer>
+struct event_dispatcher<Observer, shard_new_client, true>
+{
+  template <class Socket>
+  static void apply(Observer& obs, const std::shared_ptr<Socket>& socket, std::size_t shard)
+  {
+    obs.shard_new_client(socket, shard);
+  }
+};
+
+template <class Observer>
+struct event_dispatcher<Observer, worker_started, true>
+{
+  static void apply(Observer& obs, std::size_t worker, boost::optional<unsigned> cpu)
+  {
+    obs.worker_started(worker, cpu);
+  }
+};
+
+template <class Observer>
+struct event_dispatcher<Observer, new_session, true>
+{
+  template <class Socket>
+  static void apply(Observer& obs, const std::shared_ptr<Socket>& socket, const session_id& id)
+  {
+    obs.new_session(socket, id);
+  }
+};
+
 } // namespace neev
 
 #endif // NEEV_SERVER_EVENTS_HPP
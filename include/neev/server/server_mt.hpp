@@ -10,6 +10,7 @@
 #define NEEV_MULTI_THREADED_SERVER_HPP
 
 #include <neev/server/basic_server.hpp>
+#include <neev/server/thread_placement.hpp>
 #include <boost/thread/thread.hpp>
 #include <stdexcept>
 #include <memory>
@@ -30,19 +31,9 @@ public:
 public:
   template <class ObserverType>
   server_mt(ObserverType&& observer, std::size_t pool_size)
-  : base_type(std::forward<ObserverType>(observer))
-  , thread_pool_size_(pool_size)
-  {
-    if(thread_pool_size_ == 0)
-    {
-      thread_pool_size_ = boost::thread::hardware_concurrency();
-      if(thread_pool_size_ == 0)
-      {
-        throw std::runtime_error("The system doesn't give information about the number of cores available.\n"
-                                 "Can't start the server with 0 thread.");
-      }
-    }
-  }
+  : base_type(std::forward<ObserverType>(observer), resolve_pool_size(pool_size))
+  , thread_pool_size_(resolve_pool_size(pool_size))
+  {}
 
   server_mt(server_mt&&) = delete;
   server_mt& operator=(server_mt&&) = delete;
@@ -50,6 +41,21 @@ public:
   server_mt& operator=(const server_mt&) = delete;
 
   using base_type::start;
+  using base_type::stop;
+  using base_type::set_accept_depth;
+  using base_type::set_listen_backlog;
+  using base_type::sessions;
+
+  /** Where the threads run, they are not pinned by default.
+  * The thread calling run() is the worker 0, its placement is restored
+  * when run() returns.
+  *
+  * \pre Must be called before run().
+  */
+  void set_thread_placement(thread_placement placement)
+  {
+    placement_ = std::move(placement);
+  }
 
   void launch(const std::string& service)
   {
@@ -57,19 +63,27 @@ public:
     run();
   }
 
+  /**
+  * \par Events
+  * - worker_started (from each thread)
+  * \see basic_server::run()
+  */
   void run()
   {
     // Create a pool of threads to run all of the io_services.
     std::vector<std::unique_ptr<boost::thread>> threads;
-    for (std::size_t i = 0; i < thread_pool_size_-1; ++i)
+    for (std::size_t i = 1; i < thread_pool_size_; ++i)
     {
       std::unique_ptr<boost::thread> thread(
-        new boost::thread(boost::bind(&this_type::run_one, this)));
+        new boost::thread(boost::bind(&this_type::run_one, this, i)));
       threads.push_back(std::move(thread));
     }
 
-    // This thread is also used.
-    base_type::run();
+    // This thread is also used, its placement is restored on return.
+    {
+      placement_guard guard;
+      run_one(0);
+    }
 
     // Wait for all threads in the pool to exit.
     for (std::size_t i = 0; i < threads.size(); ++i)
@@ -82,12 +96,30 @@ public:
   }
 
 private:
-  void run_one()
+  // The session table has a shard per thread.
+  static std::size_t resolve_pool_size(std::size_t pool_size)
+  {
+    if(pool_size == 0)
+    {
+      pool_size = boost::thread::hardware_concurrency();
+      if(pool_size == 0)
+      {
+        throw std::runtime_error("The system doesn't give information about the number of cores available.\n"
+                                 "Can't start the server with 0 thread.");
+      }
+    }
+    return pool_size;
+  }
+
+  void run_one(std::size_t worker)
   {
-    base_type::run();
+    boost::optional<unsigned> cpu = placement_.apply(worker);
+    dispatch_event<worker_started>(this->get_observer(), worker, cpu);
+    base_type::run_worker(worker);
   }
 
   std::size_t thread_pool_size_;
+  thread_placement placement_;
 };
 
 } // namespace neev
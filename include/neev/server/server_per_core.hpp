@@ -0,0 +1,413 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#ifndef NEEV_SERVER_SERVER_PER_CORE_HPP
+#define NEEV_SERVER_SERVER_PER_CORE_HPP
+
+#include <neev/server/basic_server.hpp>
+#include <neev/server/thread_placement.hpp>
+#include <boost/thread/thread.hpp>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace neev{
+
+#ifdef SO_REUSEPORT
+/** Socket option allowing several sockets to listen on the same endpoint,
+* the kernel distributes the new connections among them.
+*/
+using reuse_port = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+/** How a server_per_core chooses the worker of a new connection.
+*/
+enum class connection_assignment
+{
+  /// The workers are chosen in turn.
+  round_robin,
+  /// The worker with the fewest connections is chosen.
+  least_loaded,
+  /// Each worker listens with its own acceptor (SO_REUSEPORT) and the kernel
+  /// chooses. Where SO_REUSEPORT is not available, this is round_robin.
+  sharded_acceptors
+};
+
+/** \brief Multi-threaded TCP server with one io_service per thread.
+*
+* Unlike server_mt, the threads don't share an io_service: each worker thread
+* runs its own io_service. An accepted socket is created on the io_service of
+* its worker (its home thread), so its transfers and handlers always run on this
+* thread, and the events new_client and shard_new_client (with the index of the
+* worker) are dispatched on it.
+*
+* If the observer subscribes to new_session, the clients are registered in the
+* session table (see sessions()), in the shard of their worker. The table
+* doesn't keep the sockets alive, so the load of a worker still decreases
+* when its sockets are released. The application can erase the session when
+* the client disconnects, otherwise the sessions of the destroyed sockets are
+* erased when their shard grows (see session_table::insert with expired_session).
+*
+* With connection_assignment::sharded_acceptors, there is no single accept
+* path: every worker accepts its own connections.
+*
+* The observer is shared by the workers and must be thread-safe.
+* The sockets must be released before the server is destroyed.
+*/
+template <class Observer>
+class server_per_core
+{
+private:
+  using this_type = server_per_core<Observer>;
+public:
+  using socket_type = boost::asio::ip::tcp::socket;
+  using socket_ptr = std::shared_ptr<socket_type>;
+  using observer_type = Observer;
+  using session_table_type = session_table<std::weak_ptr<socket_type>>;
+
+private:
+  using connection_counter = std::shared_ptr<std::atomic<std::size_t>>;
+
+  struct worker
+  {
+    explicit worker(std::size_t index)
+    : index(index)
+    , io_service()
+    , work(io_service)
+    , connections(std::make_shared<std::atomic<std::size_t>>(0))
+    {}
+
+    std::size_t index;
+    boost::asio::io_service io_service;
+    // The io_service doesn't run out of work between connections.
+    boost::asio::io_service::work work;
+    connection_counter connections;
+  };
+
+  // Custom deleter of the sockets, the load of a worker decreases when the
+  // last reference to one of its sockets is released.
+  struct release_connection
+  {
+    connection_counter connections;
+
+    void operator()(socket_type* socket) const
+    {
+      --*connections;
+      delete socket;
+    }
+  };
+
+public:
+  /**
+  * \param pool_size is the number of worker threads, 0 means one per core.
+  */
+  template <class ObserverType>
+  server_per_core(ObserverType&& observer, std::size_t pool_size,
+    connection_assignment assignment = connection_assignment::round_robin)
+  : observer_(std::forward<ObserverType>(observer))
+  , workers_(make_workers(pool_size))
+  , assignment_(assignment)
+  , next_worker_(0)
+  , server_on_(false)
+  , sessions_(workers_.size())
+  {
+#ifndef SO_REUSEPORT
+    if(assignment_ == connection_assignment::sharded_acceptors)
+      assignment_ = connection_assignment::round_robin;
+#endif
+    std::size_t acceptors = is_sharded() ? workers_.size() : 1;
+    for(std::size_t i = 0; i < acceptors; ++i)
+    {
+      acceptors_.emplace_back(new boost::asio::ip::tcp::acceptor(workers_[i]->io_service));
+    }
+  }
+
+  ~server_per_core()
+  {
+    // The pending accept of a single acceptor holds a socket of another worker,
+    // the io_service of the acceptor is destroyed first.
+    acceptors_.clear();
+    workers_.front().reset();
+  }
+
+  server_per_core(server_per_core&&) = delete;
+  server_per_core& operator=(server_per_core&&) = delete;
+  server_per_core(const server_per_core&) = delete;
+  server_per_core& operator=(const server_per_core&) = delete;
+
+  /** Register asynchronous operation to start the server
+  * when run() will be called.
+  *
+  * \see basic_server::start()
+  */
+  void start(const std::string& service)
+  {
+    boost::asio::ip::tcp::endpoint endpoint;
+    if(!listen(service, endpoint))
+    {
+      dispatch_event<start_failure>(observer_);
+    }
+    else
+    {
+      server_on_ = true;
+      for(std::size_t i = 0; i < acceptors_.size(); ++i)
+        start_accept(i);
+      dispatch_event<start_success>(observer_, endpoint);
+    }
+  }
+
+  /** Where the workers run, they are not pinned by default.
+  * The thread calling run() is the worker 0, its placement is restored
+  * when run() returns.
+  *
+  * \pre Must be called before run().
+  */
+  void set_thread_placement(thread_placement placement)
+  {
+    placement_ = std::move(placement);
+  }
+
+  /** Run every worker, the calling thread is the first one.
+  *
+  * \return returns when the server is stopped.
+  * \see basic_server::run()
+  *
+  * \par Events
+  * - worker_started (from each worker)
+  */
+  void run()
+  {
+    std::vector<std::unique_ptr<boost::thread>> threads;
+    for (std::size_t i = 1; i < workers_.size(); ++i)
+    {
+      std::unique_ptr<boost::thread> thread(
+        new boost::thread(std::bind(&this_type::run_worker, this, i)));
+      threads.push_back(std::move(thread));
+    }
+
+    {
+      placement_guard guard;
+      run_worker(0);
+    }
+
+    for (std::size_t i = 0; i < threads.size(); ++i)
+      threads[i]->join();
+  }
+
+  void launch(const std::string& service)
+  {
+    start(service);
+    run();
+  }
+
+  /** Stop request on the server, every worker is stopped.
+  *
+  * \see basic_server::stop()
+  */
+  void stop()
+  {
+    server_on_ = false;
+    for(std::size_t i = 0; i < workers_.size(); ++i)
+      workers_[i]->io_service.stop();
+  }
+
+  std::size_t thread_pool_size() const
+  {
+    return workers_.size();
+  }
+
+  /**
+  * \return the sessions of the clients, the shard i is the one of the worker i.
+  * \see basic_server::sessions()
+  */
+  session_table_type& sessions()
+  {
+    return sessions_;
+  }
+
+  /**
+  * \return the io_service of the worker (0 <= worker < thread_pool_size()).
+  */
+  boost::asio::io_service& get_io_service(std::size_t worker)
+  {
+    return workers_[worker]->io_service;
+  }
+
+  /**
+  * \return the number of connections served by the worker.
+  */
+  std::size_t connections(std::size_t worker) const
+  {
+    return *workers_[worker]->connections;
+  }
+
+private:
+  static std::vector<std::unique_ptr<worker>> make_workers(std::size_t pool_size)
+  {
+    if(pool_size == 0)
+    {
+      pool_size = boost::thread::hardware_concurrency();
+      if(pool_size == 0)
+      {
+        throw std::runtime_error("The system doesn't give information about the number of cores available.\n"
+                                 "Can't start the server with 0 thread.");
+      }
+    }
+    std::vector<std::unique_ptr<worker>> workers;
+    for(std::size_t i = 0; i < pool_size; ++i)
+      workers.emplace_back(new worker(i));
+    return workers;
+  }
+
+  bool is_sharded() const
+  {
+    return assignment_ == connection_assignment::sharded_acceptors;
+  }
+
+  // The other acceptors listen on the local endpoint of the first one, with
+  // the same port if it was chosen by the system.
+  bool listen(const std::string& service, boost::asio::ip::tcp::endpoint& endpoint)
+  {
+    if(!is_sharded())
+    {
+      return detail::listen_on_service(*acceptors_.front(), service, observer_, endpoint);
+    }
+#ifdef SO_REUSEPORT
+    auto configure = [](boost::asio::ip::tcp::acceptor& acceptor)
+    {
+      acceptor.set_option(reuse_port(true));
+    };
+    if(!detail::listen_on_service(*acceptors_.front(), service, observer_, endpoint,
+      boost::asio::socket_base::max_connections, configure))
+    {
+      return false;
+    }
+    try
+    {
+      endpoint = acceptors_.front()->local_endpoint();
+      for(std::size_t i = 1; i < acceptors_.size(); ++i)
+      {
+        acceptors_[i]->open(endpoint.protocol());
+        configure(*acceptors_[i]);
+        acceptors_[i]->bind(endpoint);
+        acceptors_[i]->listen();
+      }
+    }
+    catch(std::exception& e)
+    {
+      dispatch_event<endpoint_failure>(observer_, e.what());
+      for(std::size_t i = 0; i < acceptors_.size(); ++i)
+      {
+        boost::system::error_code ignore;
+        acceptors_[i]->close(ignore);
+      }
+      return false;
+    }
+#endif
+    return true;
+  }
+
+  void run_worker(std::size_t i)
+  {
+    boost::optional<unsigned> cpu = placement_.apply(i);
+    dispatch_event<worker_started>(observer_, i, cpu);
+    while(server_on_)
+    {
+      try
+      {
+        workers_[i]->io_service.run();
+      }
+      catch(std::exception& e)
+      {
+        dispatch_event<run_exception>(observer_, e);
+      }
+      catch(...)
+      {
+        dispatch_event<run_unknown_exception>(observer_, std::current_exception());
+      }
+    }
+  }
+
+  // Only called by the thread of the acceptor.
+  worker& choose_worker()
+  {
+    if(assignment_ == connection_assignment::least_loaded)
+    {
+      std::size_t chosen = 0;
+      for(std::size_t i = 1; i < workers_.size(); ++i)
+      {
+        if(*workers_[i]->connections < *workers_[chosen]->connections)
+          chosen = i;
+      }
+      return *workers_[chosen];
+    }
+    else
+    {
+      next_worker_ = (next_worker_ + 1) % workers_.size();
+      return *workers_[next_worker_];
+    }
+  }
+
+  void start_accept(std::size_t acceptor)
+  {
+    using std::placeholders::_1;
+    // A sharded acceptor only accepts the connections of its worker.
+    worker& home = is_sharded() ? *workers_[acceptor] : choose_worker();
+    // The pending connection is counted, so least_loaded doesn't choose the
+    // same worker for each accept of a burst.
+    ++*home.connections;
+    socket_ptr socket(new socket_type(home.io_service), release_connection{home.connections});
+    acceptors_[acceptor]->async_accept(*socket,
+      std::bind(&this_type::handle_accept, this, acceptor, home.index, socket, _1)
+    );
+  }
+
+  void handle_accept(std::size_t acceptor, std::size_t home,
+    const socket_ptr& socket, const boost::system::error_code& e)
+  {
+    if (!e)
+    {
+      if(is_sharded())
+      {
+        dispatch_new_client(socket, home);
+      }
+      else
+      {
+        workers_[home]->io_service.post(
+          std::bind(&this_type::dispatch_new_client, this, socket, home));
+      }
+    }
+    start_accept(acceptor);
+  }
+
+  void dispatch_new_client(const socket_ptr& socket, std::size_t home)
+  {
+    dispatch_event<new_client>(observer_, socket);
+    dispatch_event<shard_new_client>(observer_, socket, home);
+    register_session(socket, home, is_subscribed<observer_type, new_session>());
+  }
+
+  void register_session(const socket_ptr&, std::size_t, std::false_type) {}
+
+  void register_session(const socket_ptr& socket, std::size_t home, std::true_type)
+  {
+    session_id id = sessions_.insert(home, socket, expired_session());
+    dispatch_event<new_session>(observer_, socket, id);
+  }
+
+  observer_type observer_;
+  std::vector<std::unique_ptr<worker>> workers_;
+  std::vector<std::unique_ptr<boost::asio::ip::tcp::acceptor>> acceptors_;
+  connection_assignment assignment_;
+  std::size_t next_worker_;
+  std::atomic<bool> server_on_;
+  thread_placement placement_;
+  session_table_type sessions_;
+};
+
+} // namespace neev
+
+#endif // NEEV_SERVER_SERVER_PER_CORE_HPP
@@ -0,0 +1,329 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Registry of the connections of a server, indexed by session_id.
+*/
+
+#ifndef NEEV_SERVER_SESSION_TABLE_HPP
+#define NEEV_SERVER_SESSION_TABLE_HPP
+
+#include <boost/assert.hpp>
+#include <boost/optional.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace neev{
+
+/** Handle of a session in a session_table.
+* A handle is never reused: once its session is erased, the handle doesn't
+* find anything even if the slot holds a new session (the generation differs).
+* The default handle is invalid.
+*/
+struct session_id
+{
+  std::uint32_t shard;
+  std::uint32_t slot;
+  std::uint32_t generation;
+
+  session_id()
+  : shard(0), slot(0), generation(0)
+  {}
+
+  session_id(std::uint32_t shard, std::uint32_t slot, std::uint32_t generation)
+  : shard(shard), slot(slot), generation(generation)
+  {}
+
+  bool is_valid() const
+  {
+    return generation != 0;
+  }
+};
+
+inline bool operator==(const session_id& a, const session_id& b)
+{
+  return a.shard == b.shard && a.slot == b.slot && a.generation == b.generation;
+}
+
+inline bool operator!=(const session_id& a, const session_id& b)
+{
+  return !(a == b);
+}
+
+/** Slot map: the values are stored in a vector, the erased slots are reused
+* and each slot has a generation incremented on erase.
+* Insertion, lookup and removal are O(1). Not thread-safe.
+*/
+template <class T>
+class slot_map
+{
+ private:
+  static constexpr std::uint32_t no_slot = std::numeric_limits<std::uint32_t>::max();
+
+  struct slot
+  {
+    T value;
+    std::uint32_t generation;
+    // The next free slot when this one is free.
+    std::uint32_t next_free;
+    bool occupied;
+  };
+
+ public:
+  slot_map()
+  : free_head_(no_slot)
+  , size_(0)
+  {}
+
+  /** @return the slot and the generation of the value.
+  */
+  std::pair<std::uint32_t, std::uint32_t> insert(T value)
+  {
+    std::uint32_t index;
+    if(free_head_ != no_slot)
+    {
+      index = free_head_;
+      free_head_ = slots_[index].next_free;
+      slots_[index].value = std::move(value);
+    }
+    else
+    {
+      BOOST_ASSERT_MSG(slots_.size() < no_slot, "slot_map::insert: Too many slots.");
+      index = static_cast<std::uint32_t>(slots_.size());
+      slots_.push_back(slot{std::move(value), 1, no_slot, false});
+    }
+    slots_[index].occupied = true;
+    ++size_;
+    return std::make_pair(index, slots_[index].generation);
+  }
+
+  // Return nullptr if the value was erased.
+  T* find(std::uint32_t index, std::uint32_t generation)
+  {
+    if(index < slots_.size() && slots_[index].occupied && slots_[index].generation == generation)
+      return &slots_[index].value;
+    else
+      return nullptr;
+  }
+
+  // The value is destroyed (replaced by T()) and its handle becomes invalid.
+  bool erase(std::uint32_t index, std::uint32_t generation)
+  {
+    if(find(index, generation) == nullptr)
+    {
+      return false;
+    }
+    slot& s = slots_[index];
+    s.value = T();
+    s.occupied = false;
+    // The generation 0 is never valid.
+    if(++s.generation == 0)
+      s.generation = 1;
+    s.next_free = free_head_;
+    free_head_ = index;
+    --size_;
+    return true;
+  }
+
+  /** Call f(slot, generation, value) on every value.
+  */
+  template <class F>
+  void for_each(F f)
+  {
+    for(std::size_t i = 0; i < slots_.size(); ++i)
+    {
+      if(slots_[i].occupied)
+        f(static_cast<std::uint32_t>(i), slots_[i].generation, slots_[i].value);
+    }
+  }
+
+  /** Erase the values for which pred(value) is true.
+  * @return the number of values erased.
+  */
+  template <class Predicate>
+  std::size_t erase_if(Predicate pred)
+  {
+    std::size_t erased = 0;
+    for(std::size_t i = 0; i < slots_.size(); ++i)
+    {
+      if(slots_[i].occupied && pred(slots_[i].value))
+      {
+        erase(static_cast<std::uint32_t>(i), slots_[i].generation);
+        ++erased;
+      }
+    }
+    return erased;
+  }
+
+  std::size_t size() const
+  {
+    return size_;
+  }
+
+ private:
+  std::vector<slot> slots_;
+  std::uint32_t free_head_;
+  std::size_t size_;
+};
+
+template <class T>
+constexpr std::uint32_t slot_map<T>::no_slot;
+
+/** Predicate of session_table::insert for the sessions held by weak_ptr:
+* a session is expired once its object is destroyed.
+*/
+struct expired_session
+{
+  template <class T>
+  bool operator()(const std::weak_ptr<T>& session) const
+  {
+    return session.expired();
+  }
+};
+
+/** Thread-safe table of sessions, split in shards with a slot_map and a mutex
+* each. The threads inserting in distinct shards don't contend, a worker
+* thread of a server usually owns a shard.
+*/
+template <class T>
+class session_table
+{
+ private:
+  // A shard is not swept before it holds that many sessions.
+  static constexpr std::size_t min_sweep_size = 64;
+
+  struct shard_type
+  {
+    shard_type()
+    : sweep_size(min_sweep_size)
+    {}
+
+    std::mutex mutex;
+    slot_map<T> sessions;
+    // Size of the shard triggering the next sweep (see insert).
+    std::size_t sweep_size;
+  };
+
+ public:
+  using value_type = T;
+
+  explicit session_table(std::size_t shards = 1)
+  {
+    BOOST_ASSERT_MSG(shards > 0, "session_table: The number of shards can't be 0.");
+    for(std::size_t i = 0; i < shards; ++i)
+      shards_.emplace_back(new shard_type);
+  }
+
+  session_table(session_table&&) = delete;
+  session_table& operator=(session_table&&) = delete;
+  session_table(const session_table&) = delete;
+  session_table& operator=(const session_table&) = delete;
+
+  session_id insert(std::size_t shard, T value)
+  {
+    BOOST_ASSERT_MSG(shard < shards_.size(), "session_table::insert: Invalid shard.");
+    shard_type& s = *shards_[shard];
+    std::lock_guard<std::mutex> lock(s.mutex);
+    std::pair<std::uint32_t, std::uint32_t> handle = s.sessions.insert(std::move(value));
+    return session_id(static_cast<std::uint32_t>(shard), handle.first, handle.second);
+  }
+
+  /** Insert value, and first erase the sessions of the shard for which
+  * expired(value) is true if the shard doubled since its last sweep.
+  * The sessions nobody erases (such as the weak_ptr of closed sockets)
+  * don't grow the shard without bound, for an amortized O(1) insertion.
+  */
+  template <class Expired>
+  session_id insert(std::size_t shard, T value, Expired expired)
+  {
+    BOOST_ASSERT_MSG(shard < shards_.size(), "session_table::insert: Invalid shard.");
+    shard_type& s = *shards_[shard];
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if(s.sessions.size() >= s.sweep_size)
+    {
+      s.sessions.erase_if(expired);
+      s.sweep_size = std::max(min_sweep_size, 2 * s.sessions.size());
+    }
+    std::pair<std::uint32_t, std::uint32_t> handle = s.sessions.insert(std::move(value));
+    return session_id(static_cast<std::uint32_t>(shard), handle.first, handle.second);
+  }
+
+  /** @return a copy of the value, none if the session was erased.
+  */
+  boost::optional<T> find(const session_id& id)
+  {
+    if(id.shard >= shards_.size())
+    {
+      return boost::optional<T>();
+    }
+    shard_type& s = *shards_[id.shard];
+    std::lock_guard<std::mutex> lock(s.mutex);
+    T* value = s.sessions.find(id.slot, id.generation);
+    if(value == nullptr)
+      return boost::optional<T>();
+    else
+      return *value;
+  }
+
+  /** @return false if the session was already erased.
+  */
+  bool erase(const session_id& id)
+  {
+    if(id.shard >= shards_.size())
+    {
+      return false;
+    }
+    shard_type& s = *shards_[id.shard];
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.sessions.erase(id.slot, id.generation);
+  }
+
+  /** Call f(id, value) on every session, a shard is locked while f is
+  * called on its sessions: f must not use this table.
+  */
+  template <class F>
+  void for_each(F f)
+  {
+    for(std::size_t i = 0; i < shards_.size(); ++i)
+    {
+      std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+      shards_[i]->sessions.for_each(
+        [&f, i](std::uint32_t slot, std::uint32_t generation, T& value)
+        {
+          f(session_id(static_cast<std::uint32_t>(i), slot, generation), value);
+        });
+    }
+  }
+
+  std::size_t size() const
+  {
+    std::size_t total = 0;
+    for(std::size_t i = 0; i < shards_.size(); ++i)
+    {
+      std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+      total += shards_[i]->sessions.size();
+    }
+    return total;
+  }
+
+  std::size_t shards() const
+  {
+    return shards_.size();
+  }
+
+ private:
+  std::vector<std::unique_ptr<shard_type>> shards_;
+};
+
+template <class T>
+constexpr std::size_t session_table<T>::min_sweep_size;
+
+} // namespace neev
+
+#endif // NEEV_SERVER_SESSION_TABLE_HPP
@@ -0,0 +1,301 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Placement of the worker threads of a server on the CPUs.
+* The topology is read from /sys, the placement only has an effect on Linux.
+*/
+
+#ifndef NEEV_SERVER_THREAD_PLACEMENT_HPP
+#define NEEV_SERVER_THREAD_PLACEMENT_HPP
+
+#include <boost/optional.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace neev{
+namespace detail{
+
+  struct cpu_topology
+  {
+    unsigned cpu;
+    int node;
+    int package;
+    int core;
+    // Rank of this hardware thread among the ones of its core.
+    int sibling;
+  };
+
+#ifdef __linux__
+  inline int read_sys_int(const std::string& path)
+  {
+    std::ifstream file(path);
+    int value = -1;
+    file >> value;
+    return file ? value : -1;
+  }
+
+  inline int numa_node_of(unsigned cpu)
+  {
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = ::opendir(path.c_str());
+    int node = -1;
+    if(dir != nullptr)
+    {
+      while(dirent* entry = ::readdir(dir))
+      {
+        std::string name = entry->d_name;
+        if(name.size() > 4 && name.compare(0, 4, "node") == 0)
+        {
+          node = std::atoi(name.c_str() + 4);
+          break;
+        }
+      }
+      ::closedir(dir);
+    }
+    return node;
+  }
+
+  // The CPUs this process may run on.
+  inline std::vector<cpu_topology> available_cpus()
+  {
+    std::vector<cpu_topology> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(::sched_getaffinity(0, sizeof(set), &set) != 0)
+    {
+      return cpus;
+    }
+    for(unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+      if(CPU_ISSET(cpu, &set))
+      {
+        std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        cpus.push_back(cpu_topology{cpu, numa_node_of(cpu),
+          read_sys_int(topology + "physical_package_id"),
+          read_sys_int(topology + "core_id"), 0});
+      }
+    }
+    for(cpu_topology& c : cpus)
+    {
+      c.sibling = static_cast<int>(std::count_if(cpus.begin(), cpus.end(),
+        [&c](const cpu_topology& other)
+        {
+          return other.package == c.package && other.core == c.core && other.cpu < c.cpu;
+        }));
+    }
+    return cpus;
+  }
+#else
+  inline int numa_node_of(unsigned)
+  {
+    return -1;
+  }
+
+  inline std::vector<cpu_topology> available_cpus()
+  {
+    return std::vector<cpu_topology>();
+  }
+#endif // __linux__
+} // namespace detail
+
+/** The CPU of each worker thread of a server, and the NUMA node of its memory.
+*
+* The worker i is pinned on the CPU i (modulo the number of CPUs) of the list.
+* By default the threads are not pinned.
+*/
+class thread_placement
+{
+ public:
+  thread_placement()
+  : bind_memory_(false)
+  {}
+
+  /** The workers are pinned on the CPUs of the list, in this order.
+  */
+  static thread_placement cpu_list(std::vector<unsigned> cpus)
+  {
+    thread_placement placement;
+    placement.cpus_ = std::move(cpus);
+    return placement;
+  }
+
+  /** The workers are pinned close together: the hardware threads of a core,
+  * then the cores of a NUMA node, are filled before the next ones.
+  */
+  static thread_placement compact()
+  {
+    std::vector<detail::cpu_topology> cpus = detail::available_cpus();
+    std::sort(cpus.begin(), cpus.end(),
+      [](const detail::cpu_topology& a, const detail::cpu_topology& b)
+      {
+        return std::make_tuple(a.node, a.package, a.core, a.sibling)
+             < std::make_tuple(b.node, b.package, b.core, b.sibling);
+      });
+    return from_topology(cpus);
+  }
+
+  /** The workers are pinned far apart: in turn on each NUMA node, and on
+  * distinct cores before sharing a core with another worker.
+  */
+  static thread_placement spread()
+  {
+    std::vector<detail::cpu_topology> cpus = detail::available_cpus();
+    std::sort(cpus.begin(), cpus.end(),
+      [](const detail::cpu_topology& a, const detail::cpu_topology& b)
+      {
+        return std::make_tuple(a.sibling, a.package, a.core, a.cpu)
+             < std::make_tuple(b.sibling, b.package, b.core, b.cpu);
+      });
+    // Interleave the nodes, keeping the order of the CPUs of each node.
+    std::vector<detail::cpu_topology> spread_cpus;
+    std::vector<bool> taken(cpus.size(), false);
+    while(spread_cpus.size() < cpus.size())
+    {
+      std::vector<int> nodes_done;
+      for(std::size_t i = 0; i < cpus.size(); ++i)
+      {
+        if(!taken[i] && std::find(nodes_done.begin(), nodes_done.end(), cpus[i].node) == nodes_done.end())
+        {
+          taken[i] = true;
+          nodes_done.push_back(cpus[i].node);
+          spread_cpus.push_back(cpus[i]);
+        }
+      }
+    }
+    return from_topology(spread_cpus);
+  }
+
+  /** The memory allocated by each pinned worker is bound to the NUMA node
+  * of its CPU (set_mempolicy(MPOL_BIND)).
+  */
+  thread_placement& bind_memory_to_node(bool bind = true)
+  {
+    bind_memory_ = bind;
+    return *this;
+  }
+
+  /** @return the CPU of the worker, none if it is not pinned.
+  */
+  boost::optional<unsigned> cpu(std::size_t worker) const
+  {
+    if(cpus_.empty())
+      return boost::optional<unsigned>();
+    else
+      return cpus_[worker % cpus_.size()];
+  }
+
+  /** Pin the calling thread on the CPU of the worker, and bind its memory
+  * if requested. A failure of the memory binding is ignored.
+  *
+  * @return the CPU of the thread, none if it is not pinned.
+  */
+  boost::optional<unsigned> apply(std::size_t worker) const
+  {
+    boost::optional<unsigned> pinned = cpu(worker);
+#ifdef __linux__
+    if(pinned)
+    {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(*pinned, &set);
+      if(::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) != 0)
+      {
+        return boost::optional<unsigned>();
+      }
+      int node = detail::numa_node_of(*pinned);
+      if(bind_memory_ && node >= 0 && node < static_cast<int>(sizeof(unsigned long) * 8))
+      {
+        const int mpol_bind = 2;
+        unsigned long nodemask = 1UL << node;
+        // The kernel ignores the last bit of maxnode.
+        ::syscall(SYS_set_mempolicy, mpol_bind, &nodemask, sizeof(nodemask) * 8 + 1);
+      }
+    }
+#else
+    pinned = boost::optional<unsigned>();
+#endif
+    return pinned;
+  }
+
+ private:
+  static thread_placement from_topology(const std::vector<detail::cpu_topology>& cpus)
+  {
+    thread_placement placement;
+    for(const detail::cpu_topology& c : cpus)
+      placement.cpus_.push_back(c.cpu);
+    return placement;
+  }
+
+  std::vector<unsigned> cpus_;
+  bool bind_memory_;
+};
+
+/** Save the CPU affinity and the memory policy of the calling thread, and
+* restore them on destruction. The thread calling run() is the worker 0 of a
+* server only until run() returns.
+*/
+class placement_guard
+{
+ public:
+  placement_guard()
+  : affinity_saved_(false)
+  , mode_(-1)
+  {
+#ifdef __linux__
+    CPU_ZERO(&affinity_);
+    affinity_saved_ = ::pthread_getaffinity_np(::pthread_self(), sizeof(affinity_), &affinity_) == 0;
+    nodemask_.fill(0);
+    if(::syscall(SYS_get_mempolicy, &mode_, nodemask_.data(), max_nodes, nullptr, 0) != 0)
+    {
+      mode_ = -1;
+    }
+#endif
+  }
+
+  placement_guard(const placement_guard&) = delete;
+  placement_guard& operator=(const placement_guard&) = delete;
+
+  ~placement_guard()
+  {
+#ifdef __linux__
+    if(affinity_saved_)
+    {
+      ::pthread_setaffinity_np(::pthread_self(), sizeof(affinity_), &affinity_);
+    }
+    if(mode_ >= 0)
+    {
+      // The kernel ignores the last bit of maxnode.
+      ::syscall(SYS_set_mempolicy, mode_, nodemask_.data(), max_nodes + 1);
+    }
+#endif
+  }
+
+ private:
+#ifdef __linux__
+  static constexpr unsigned long max_nodes = 16 * sizeof(unsigned long) * 8;
+
+  cpu_set_t affinity_;
+  std::array<unsigned long, 16> nodemask_;
+#endif
+  bool affinity_saved_;
+  int mode_;
+};
+
+} // namespace neev
+
+#endif // NEEV_SERVER_THREAD_PLACEMENT_HPP
@@ -0,0 +1,288 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Thread-local pool of raw byte blocks sorted in power-of-two size classes.
+*/
+
+#ifndef NEEV_SLAB_POOL_HPP
+#define NEEV_SLAB_POOL_HPP
+
+#include <neev/detail/thread_cache.hpp>
+#include <boost/assert.hpp>
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace neev{
+namespace detail{
+
+  /** Free lists of blocks, one list per size class and one cache per thread.
+  * A block can be released by another thread than the one allocating it,
+  * it then goes to the cache of the releasing thread.
+  */
+  class slab_cache
+  : public thread_cache<slab_cache>
+  {
+  public:
+    static constexpr std::size_t min_class_bits = 6;
+    // The last class holds 4 GiB (1 GiB if std::size_t has 32 bits).
+    static constexpr std::size_t classes = sizeof(std::size_t) * CHAR_BIT > 32 ? 27 : 25;
+    // Blocks larger than the last class are not pooled.
+    static constexpr std::size_t unpooled = classes;
+
+    static_assert(min_class_bits + classes - 1 < sizeof(std::size_t) * CHAR_BIT,
+      "The size of the last class must fit in a std::size_t.");
+
+    ~slab_cache()
+    {
+      clear();
+    }
+
+    static void* allocate_unpooled(std::size_t size_class, std::size_t size)
+    {
+      return ::operator new(size_class == unpooled ? size : class_size(size_class));
+    }
+
+    /** @return the smallest class holding size bytes, or unpooled.
+    */
+    static std::size_t class_of(std::size_t size)
+    {
+      std::size_t size_class = 0;
+      while(size_class < classes && class_size(size_class) < size)
+      {
+        ++size_class;
+      }
+      return size_class;
+    }
+
+    static std::size_t class_size(std::size_t size_class)
+    {
+      return std::size_t(1) << (size_class + min_class_bits);
+    }
+
+    void* allocate(std::size_t size_class, std::size_t size)
+    {
+      if(size_class == unpooled)
+      {
+        return ::operator new(size);
+      }
+      std::vector<void*>& free_list = free_lists_[size_class];
+      if(free_list.empty())
+      {
+        return ::operator new(class_size(size_class));
+      }
+      void* block = free_list.back();
+      free_list.pop_back();
+      cached_bytes_ -= class_size(size_class);
+      return block;
+    }
+
+    void deallocate(void* block, std::size_t size_class)
+    {
+      if(size_class != unpooled && cached_bytes_ + class_size(size_class) <= max_cached_bytes_)
+      {
+        free_lists_[size_class].push_back(block);
+        cached_bytes_ += class_size(size_class);
+      }
+      else
+      {
+        ::operator delete(block);
+      }
+    }
+
+    void clear()
+    {
+      for(std::vector<void*>& free_list : free_lists_)
+      {
+        for(void* block : free_list)
+        {
+          ::operator delete(block);
+        }
+        free_list.clear();
+      }
+      cached_bytes_ = 0;
+    }
+
+    std::size_t cached_bytes() const { return cached_bytes_; }
+
+    std::size_t max_cached_bytes() const { return max_cached_bytes_; }
+    void max_cached_bytes(std::size_t n) { max_cached_bytes_ = n; }
+
+  private:
+    friend class thread_cache<slab_cache>;
+
+    slab_cache()
+    : cached_bytes_(0)
+    , max_cached_bytes_(16 * 1024 * 1024)
+    {}
+
+    std::array<std::vector<void*>, classes> free_lists_;
+    std::size_t cached_bytes_;
+    std::size_t max_cached_bytes_;
+  };
+} // namespace detail
+
+/** Manage the slab cache of the calling thread.
+*/
+struct slab_pool
+{
+  /** Maximum number of bytes kept in the cache of this thread (16 MiB by default),
+  * the blocks released beyond it are freed.
+  */
+  static void max_cached_bytes(std::size_t n)
+  {
+    if(detail::slab_cache* cache = detail::slab_cache::local())
+    {
+      cache->max_cached_bytes(n);
+    }
+  }
+
+  static std::size_t max_cached_bytes()
+  {
+    detail::slab_cache* cache = detail::slab_cache::local();
+    return cache != nullptr ? cache->max_cached_bytes() : 0;
+  }
+
+  static std::size_t cached_bytes()
+  {
+    detail::slab_cache* cache = detail::slab_cache::local();
+    return cache != nullptr ? cache->cached_bytes() : 0;
+  }
+
+  /** Free the blocks cached by this thread.
+  */
+  static void clear()
+  {
+    if(detail::slab_cache* cache = detail::slab_cache::local())
+    {
+      cache->clear();
+    }
+  }
+};
+
+/** Move-only array of bytes taken from the slab pool and given back on destruction.
+* The bytes are not initialized.
+*/
+class pooled_bytes
+{
+ public:
+  using value_type = char;
+  using iterator = char*;
+  using const_iterator = const char*;
+
+  pooled_bytes()
+  : data_(nullptr)
+  , size_(0)
+  , size_class_(0)
+  {}
+
+  explicit pooled_bytes(std::size_t size)
+  : data_(nullptr)
+  , size_(size)
+  , size_class_(detail::slab_cache::class_of(size))
+  {
+    if(size_ != 0)
+    {
+      data_ = static_cast<char*>(detail::slab_cache::allocate_local(size_class_, size_));
+    }
+  }
+
+  pooled_bytes(pooled_bytes&& other)
+  : data_(other.data_)
+  , size_(other.size_)
+  , size_class_(other.size_class_)
+  {
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+
+  pooled_bytes& operator=(pooled_bytes&& other)
+  {
+    if(this != &other)
+    {
+      release();
+      data_ = other.data_;
+      size_ = other.size_;
+      size_class_ = other.size_class_;
+      other.data_ = nullptr;
+      other.size_ = 0;
+    }
+    return *this;
+  }
+
+  pooled_bytes(const pooled_bytes&) = delete;
+  pooled_bytes& operator=(const pooled_bytes&) = delete;
+
+  ~pooled_bytes()
+  {
+    release();
+  }
+
+  char* data() { return data_; }
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  iterator begin() { return data_; }
+  iterator end() { return data_ + size_; }
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+  char& operator[](std::size_t i) { return data_[i]; }
+  const char& operator[](std::size_t i) const { return data_[i]; }
+
+  /** @return the number of bytes usable without a new allocation.
+  */
+  std::size_t capacity() const
+  {
+    if(data_ == nullptr)
+      return 0;
+    else if(size_class_ == detail::slab_cache::unpooled)
+      return size_;
+    else
+      return detail::slab_cache::class_size(size_class_);
+  }
+
+  /** Change the size, the block is only replaced if the capacity is too small.
+  * The content is not preserved in this case, and the new bytes are never initialized.
+  */
+  void resize(std::size_t size)
+  {
+    if(size > capacity())
+    {
+      *this = pooled_bytes(size);
+    }
+    else
+    {
+      size_ = size;
+    }
+  }
+
+  std::string str() const
+  {
+    return std::string(data_, size_);
+  }
+
+ private:
+  void release()
+  {
+    if(data_ != nullptr)
+    {
+      detail::slab_cache::deallocate_local(data_, size_class_);
+      data_ = nullptr;
+    }
+  }
+
+  char* data_;
+  std::size_t size_;
+  std::size_t size_class_;
+};
+
+} // namespace neev
+
+#endif // NEEV_SLAB_POOL_HPP
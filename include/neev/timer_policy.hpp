@@ -7,9 +7,13 @@
 #define NEEV_TIMEOUT_POLICY_HPP
 
 #include <neev/transfer_events.hpp>
+#include <neev/timing_wheel.hpp>
 #include <boost/asio.hpp>
 #include <boost/assert.hpp>
 #include <functional>
+#include <memory>
+#include <utility>
+#include <atomic>
 
 namespace neev{
 
@@ -27,6 +31,14 @@ struct no_timer
   {
     return false;
   }
+
+  void disarm() {}
+
+  template <class Handler>
+  void post(boost::asio::io_service& io_service, Handler handler) const
+  {
+    io_service.post(handler);
+  }
 };
 
 struct transfer_timer
@@ -64,12 +76,22 @@ struct transfer_timer
     return timed_out_;
   }
 
-private:
-  void cancel_timeout()
+  /** Stop the timer, called once the transfer is completed or failed.
+  */
+  void disarm()
   {
-    timer_.cancel();
+    boost::system::error_code ignore;
+    timer_.cancel(ignore);
   }
 
+  template <class Handler>
+  void post(boost::asio::io_service&, Handler handler)
+  {
+    strand_.post(handler);
+  }
+
+private:
+
   template <class TransferOpCRTP>
   void on_timeout(const boost::system::error_code& error)
   {    
@@ -87,6 +109,107 @@ private:
   boost::asio::strand strand_;
 };
 
+/** Timer policy registering the timeouts in the timing_wheel of the io_service.
+* Unlike transfer_timer, it doesn't need a kernel timer per transfer.
+* The timeouts are rounded up to the resolution of the wheel.
+*
+* The wheel only keeps a weak reference to the transfer. On expiry, the
+* cancellation is posted with a strong reference to the strand wrapping the
+* handlers of the transfer, it is never done by the thread advancing the wheel
+* and never runs concurrently with a completion handler.
+*/
+struct wheel_timer
+{
+  wheel_timer(boost::asio::io_service & io_service)
+  : wheel_(boost::asio::use_service<timing_wheel>(io_service))
+  , timed_out_(false)
+  , strand_(io_service)
+  {}
+
+  wheel_timer(wheel_timer&&) = delete;
+  wheel_timer& operator=(wheel_timer&&) = delete;
+  wheel_timer(const wheel_timer&) = delete;
+  wheel_timer& operator=(const wheel_timer&) = delete;
+
+  // The transfer is already unreachable from the wheel (transfer_ is expired),
+  // the entry just needs to be unlinked before being destroyed.
+  ~wheel_timer()
+  {
+    wheel_.cancel(entry_);
+  }
+
+  template <class Handler>
+  auto wrap(Handler handler) -> decltype(std::declval<boost::asio::strand&>().wrap(handler))
+  {
+    return strand_.wrap(handler);
+  }
+
+  /** Pre: the transfer is owned by a std::shared_ptr.
+  */
+  template <class TransferOpCRTP>
+  void launch(const boost::posix_time::time_duration& timeout)
+  {
+    BOOST_ASSERT_MSG(timeout.total_nanoseconds() != 0, 
+      "You can't launch an operation with a timer sets at 0 seconds.");
+    TransferOpCRTP* transfer_op = static_cast<TransferOpCRTP*>(this);
+    if(!transfer_op->is_done())
+    {
+      transfer_ = transfer_op->shared_from_this();
+      wheel_.arm(entry_, timeout, &wheel_timer::on_expiry<TransferOpCRTP>, this);
+    }
+  }
+
+  bool is_timed_out() const
+  {
+    return timed_out_;
+  }
+
+  /** Remove the entry from the wheel, called once the transfer is completed or failed.
+  */
+  void disarm()
+  {
+    wheel_.cancel(entry_);
+  }
+
+  template <class Handler>
+  void post(boost::asio::io_service&, Handler handler)
+  {
+    strand_.post(handler);
+  }
+
+private:
+  // Called by the thread advancing the wheel, with the wheel locked.
+  // The transfer is being destroyed if it can't be locked anymore.
+  template <class TransferOpCRTP>
+  static void on_expiry(void* context)
+  {
+    wheel_timer* self = static_cast<wheel_timer*>(context);
+    std::shared_ptr<TransferOpCRTP> transfer_op =
+      std::static_pointer_cast<TransferOpCRTP>(self->transfer_.lock());
+    if(transfer_op)
+    {
+      self->strand_.post(std::bind(&wheel_timer::on_timeout<TransferOpCRTP>, transfer_op));
+    }
+  }
+
+  template <class TransferOpCRTP>
+  static void on_timeout(const std::shared_ptr<TransferOpCRTP>& transfer_op)
+  {
+    if(!transfer_op->is_done())
+    {
+      boost::system::error_code ignore;
+      static_cast<wheel_timer&>(*transfer_op).timed_out_ = true;
+      transfer_op->cancel(ignore);
+    }
+  }
+
+  timing_wheel& wheel_;
+  timing_wheel::entry entry_;
+  std::weak_ptr<void> transfer_;
+  std::atomic<bool> timed_out_;
+  boost::asio::strand strand_;
+};
+
 } // namespace neev
 
 #endif // NEEV_TIMEOUT_POLICY_HPP
@@ -0,0 +1,323 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Hierarchical timing wheel shared by all the timers of an io_service.
+*/
+
+#ifndef NEEV_TIMING_WHEEL_HPP
+#define NEEV_TIMING_WHEEL_HPP
+
+#include <boost/asio.hpp>
+#include <boost/assert.hpp>
+#include <functional>
+#include <cstdint>
+#include <mutex>
+
+namespace neev{
+
+/** Io_service service managing a large number of timeouts with a single timer.
+*
+* The time is divided in ticks of a fixed resolution. The entries are stored
+* in the slots of four wheels (256 slots, then 3 times 64 slots), each
+* slot of a wheel covering a whole turn of the previous one. Arming, re-arming
+* and cancelling an entry are O(1). While at least one entry is armed, a
+* single timer of type Timer advances the wheel every tick and expires
+* the entries of the current slot.
+*
+* Use it through boost::asio::use_service<timing_wheel>(io_service).
+*
+* @note The expiration callbacks are called while the wheel is locked, they
+* must not arm or cancel entries of the same wheel.
+*/
+template <class Timer = boost::asio::deadline_timer>
+class basic_timing_wheel
+: public boost::asio::io_service::service
+{
+public:
+  using timer_type = Timer;
+  using duration_type = typename timer_type::duration_type;
+  using time_type = typename timer_type::time_type;
+  using traits_type = typename timer_type::traits_type;
+  using callback_type = void (*)(void*);
+
+  static boost::asio::io_service::id id;
+
+  /** Timeout registered in the wheel, usually a member of the object timed out.
+  * It must be cancelled before being destroyed.
+  */
+  class entry
+  {
+  public:
+    entry()
+    : prev_(nullptr)
+    , next_(nullptr)
+    , expiry_(0)
+    , callback_(nullptr)
+    , context_(nullptr)
+    {}
+
+    entry(entry&&) = delete;
+    entry& operator=(entry&&) = delete;
+    entry(const entry&) = delete;
+    entry& operator=(const entry&) = delete;
+
+    bool is_armed() const
+    {
+      return prev_ != nullptr;
+    }
+
+  private:
+    friend class basic_timing_wheel;
+
+    entry* prev_;
+    entry* next_;
+    std::uint64_t expiry_;
+    callback_type callback_;
+    void* context_;
+  };
+
+private:
+  static constexpr std::size_t root_bits = 8;
+  static constexpr std::size_t level_bits = 6;
+  static constexpr std::size_t root_size = 1 << root_bits;
+  static constexpr std::size_t level_size = 1 << level_bits;
+  static constexpr std::size_t levels = 3;
+  static constexpr std::uint64_t max_ticks = (std::uint64_t(1) << (root_bits + levels * level_bits)) - 1;
+
+public:
+  explicit basic_timing_wheel(boost::asio::io_service& io_service)
+  : boost::asio::io_service::service(io_service)
+  , timer_(io_service)
+  , resolution_(boost::posix_time::milliseconds(10))
+  , current_tick_(0)
+  , armed_(0)
+  , ticking_(false)
+  {
+    for(entry& slot : root_)
+    {
+      make_empty(slot);
+    }
+    for(auto& level : levels_)
+    {
+      for(entry& slot : level)
+      {
+        make_empty(slot);
+      }
+    }
+  }
+
+  /** Set the duration of a tick, the timeouts are rounded up to it.
+  * It only applies to the entries armed afterwards.
+  */
+  void resolution(const duration_type& tick)
+  {
+    BOOST_ASSERT_MSG(tick.total_nanoseconds() != 0,
+      "timing_wheel: The resolution can't be 0.");
+    std::lock_guard<std::mutex> lock(mutex_);
+    resolution_ = tick;
+  }
+
+  duration_type resolution() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return resolution_;
+  }
+
+  /** Arm (or re-arm) the entry, callback(context) is called once the
+  * timeout is expired unless the entry is cancelled before.
+  */
+  void arm(entry& e, const duration_type& timeout, callback_type callback, void* context)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(e.is_armed())
+    {
+      unlink(e);
+    }
+    else
+    {
+      ++armed_;
+    }
+    std::uint64_t ticks = (timeout.total_microseconds() + resolution_.total_microseconds() - 1)
+      / resolution_.total_microseconds();
+    if(ticks == 0)
+    {
+      ticks = 1;
+    }
+    else if(ticks > max_ticks)
+    {
+      ticks = max_ticks;
+    }
+    e.expiry_ = current_tick_ + ticks;
+    e.callback_ = callback;
+    e.context_ = context;
+    insert(e);
+    if(!ticking_)
+    {
+      ticking_ = true;
+      last_tick_ = traits_type::now();
+      schedule_tick();
+    }
+  }
+
+  /** Remove the entry from the wheel, no effect if it is not armed.
+  */
+  void cancel(entry& e)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(e.is_armed())
+    {
+      unlink(e);
+      --armed_;
+    }
+  }
+
+private:
+  void shutdown_service()
+  {
+    boost::system::error_code ignore;
+    timer_.cancel(ignore);
+  }
+
+  // Name of shutdown_service() in the recent versions of Asio.
+  void shutdown()
+  {
+    shutdown_service();
+  }
+
+  static void make_empty(entry& slot)
+  {
+    slot.prev_ = &slot;
+    slot.next_ = &slot;
+  }
+
+  static void link(entry& slot, entry& e)
+  {
+    e.prev_ = slot.prev_;
+    e.next_ = &slot;
+    slot.prev_->next_ = &e;
+    slot.prev_ = &e;
+  }
+
+  static void unlink(entry& e)
+  {
+    e.prev_->next_ = e.next_;
+    e.next_->prev_ = e.prev_;
+    e.prev_ = nullptr;
+    e.next_ = nullptr;
+  }
+
+  void insert(entry& e)
+  {
+    std::uint64_t delta = e.expiry_ - current_tick_;
+    if(delta < root_size)
+    {
+      link(root_[e.expiry_ & (root_size - 1)], e);
+    }
+    else
+    {
+      std::size_t level = 0;
+      while(level + 1 < levels && delta >= (std::uint64_t(1) << (root_bits + (level + 1) * level_bits)))
+      {
+        ++level;
+      }
+      std::size_t shift = root_bits + level * level_bits;
+      link(levels_[level][(e.expiry_ >> shift) & (level_size - 1)], e);
+    }
+  }
+
+  // Move the entries of a slot of an upper level to the lower levels.
+  void cascade(entry& slot)
+  {
+    entry pending;
+    make_empty(pending);
+    if(slot.next_ != &slot)
+    {
+      pending.next_ = slot.next_;
+      pending.prev_ = slot.prev_;
+      pending.next_->prev_ = &pending;
+      pending.prev_->next_ = &pending;
+      make_empty(slot);
+    }
+    while(pending.next_ != &pending)
+    {
+      entry& e = *pending.next_;
+      unlink(e);
+      insert(e);
+    }
+  }
+
+  void advance()
+  {
+    ++current_tick_;
+    std::size_t index = current_tick_ & (root_size - 1);
+    for(std::size_t level = 0; index == 0 && level < levels; ++level)
+    {
+      std::size_t shift = root_bits + level * level_bits;
+      index = (current_tick_ >> shift) & (level_size - 1);
+      cascade(levels_[level][index]);
+    }
+    entry& slot = root_[current_tick_ & (root_size - 1)];
+    while(slot.next_ != &slot)
+    {
+      entry& e = *slot.next_;
+      unlink(e);
+      --armed_;
+      e.callback_(e.context_);
+    }
+  }
+
+  // Pre: mutex_ is locked.
+  void schedule_tick()
+  {
+    using std::placeholders::_1;
+    last_tick_ += resolution_;
+    timer_.expires_at(last_tick_);
+    timer_.async_wait(std::bind(&basic_timing_wheel::on_tick, this, _1));
+  }
+
+  void on_tick(const boost::system::error_code& error)
+  {
+    if(error)
+    {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    advance();
+    // Catch up with the ticks missed if the io_service was busy.
+    time_type now = traits_type::now();
+    while(armed_ != 0 && last_tick_ + resolution_ <= now)
+    {
+      last_tick_ += resolution_;
+      advance();
+    }
+    if(armed_ == 0)
+    {
+      ticking_ = false;
+    }
+    else
+    {
+      schedule_tick();
+    }
+  }
+
+  timer_type timer_;
+  mutable std::mutex mutex_;
+  duration_type resolution_;
+  time_type last_tick_;
+  std::uint64_t current_tick_;
+  std::size_t armed_;
+  bool ticking_;
+  entry root_[root_size];
+  entry levels_[levels][level_size];
+};
+
+template <class Timer>
+boost::asio::io_service::id basic_timing_wheel<Timer>::id;
+
+using timing_wheel = basic_timing_wheel<>;
+
+} // namespace neev
+
+#endif // NEEV_TIMING_WHEEL_HPP
@@ -0,0 +1,84 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Detection of the optional members of the buffer provider concept.
+*/
+
+#ifndef NEEV_BUFFER_PROVIDER_TRAITS_HPP
+#define NEEV_BUFFER_PROVIDER_TRAITS_HPP
+
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+namespace neev{
+namespace detail{
+
+  template <class BufferProvider>
+  struct has_reset_impl
+  {
+    template <class U>
+    static auto test(int) -> decltype(std::declval<U&>().reset(), std::true_type());
+
+    template <class>
+    static std::false_type test(...);
+
+    using type = decltype(test<BufferProvider>(0));
+  };
+
+  template <class BufferProvider>
+  struct has_wait_next_chunk_impl
+  {
+    template <class U>
+    static auto test(int) -> decltype(
+      std::declval<U&>().wait_next_chunk(std::declval<std::function<void()>>()), std::true_type());
+
+    template <class>
+    static std::false_type test(...);
+
+    using type = decltype(test<BufferProvider>(0));
+  };
+
+  template <class BufferProvider>
+  struct has_verify_impl
+  {
+    template <class U>
+    static auto test(int) -> decltype(std::declval<U&>().verify(), std::true_type());
+
+    template <class>
+    static std::false_type test(...);
+
+    using type = decltype(test<BufferProvider>(0));
+  };
+} // namespace detail
+
+/** True if the buffer provider can be prepared for a new message with reset().
+*/
+template <class BufferProvider>
+struct has_reset : detail::has_reset_impl<BufferProvider>::type {};
+
+/** True if the buffer provider can make the transfer wait before the next chunk.
+* wait_next_chunk(resume) returns true if next_chunk() can be called right away,
+* otherwise resume() is called later, possibly from another thread, when it can.
+*
+* Such a provider also has:
+* - cancel_wait(): called when the transfer is cancelled while waiting,
+*   returns true if resume() will never be called.
+* - abandon(): called instead of next_chunk() if the transfer was cancelled
+*   once resume() has been called, it gives back what was waited for.
+*/
+template <class BufferProvider>
+struct has_wait_next_chunk : detail::has_wait_next_chunk_impl<BufferProvider>::type {};
+
+/** True if the buffer provider checks the message once it is transferred.
+* verify() returns an error code, transfer_error is dispatched instead of
+* transfer_complete if it is set.
+*/
+template <class BufferProvider>
+struct has_verify : detail::has_verify_impl<BufferProvider>::type {};
+
+} // namespace neev
+
+#endif // NEEV_BUFFER_PROVIDER_TRAITS_HPP
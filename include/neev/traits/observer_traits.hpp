@@ -8,6 +8,7 @@
 
 #include <boost/mpl/set.hpp>
 #include <boost/mpl/contains.hpp>
+#include <type_traits>
 
 namespace neev{
 
@@ -20,6 +21,15 @@ struct observer_traits
   using events_type = typename Observer::events_type;
 };
 
+/** True if the observer subscribes to the event.
+*/
+template <class Observer, class Event>
+struct is_subscribed
+: std::integral_constant<bool, boost::mpl::contains<
+    typename observer_traits<Observer>::events_type,
+    Event>::type::value>
+{};
+
 template <class Observer, typename Event, 
   bool must_call = boost::mpl::contains<
     typename observer_traits<Observer>::events_type,
@@ -22,6 +22,18 @@ struct transfer_error;
 */
 struct transfer_on_going;
 
+/** The transfer waits for memory before receiving the next chunk (see memory_budget).
+*/
+struct transfer_paused;
+
+/** The memory is available, the transfer goes on.
+*/
+struct transfer_resumed;
+
+/** Data queued for sending and dropped because the transfer failed (see send_queue).
+*/
+struct transfer_dropped;
+
 template <class Observer>
 struct event_dispatcher<Observer, transfer_complete, true>
 {
@@ -52,6 +64,34 @@ struct event_dispatcher<Observer, transfer_on_going, true>
   }
 };
 
+template <class Observer>
+struct event_dispatcher<Observer, transfer_paused, true>
+{
+  static void apply(Observer& obs)
+  {
+    obs.transfer_paused();
+  }
+};
+
+template <class Observer>
+struct event_dispatcher<Observer, transfer_resumed, true>
+{
+  static void apply(Observer& obs)
+  {
+    obs.transfer_resumed();
+  }
+};
+
+template <class Observer>
+struct event_dispatcher<Observer, transfer_dropped, true>
+{
+  template <class Data>
+  static void apply(Observer& obs, Data&& data)
+  {
+    obs.transfer_dropped(std::forward<Data>(data));
+  }
+};
+
 } // namespace neev
 
 #endif // NEEV_TRANSFER_EVENTS_HPP
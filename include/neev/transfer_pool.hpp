@@ -0,0 +1,232 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+/** @file Recycle the memory of network_transfer objects instead of allocating
+* a new one for every message.
+*/
+
+#ifndef NEEV_TRANSFER_POOL_HPP
+#define NEEV_TRANSFER_POOL_HPP
+
+#include <neev/network_transfer.hpp>
+#include <neev/detail/thread_cache.hpp>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <new>
+
+namespace neev{
+namespace detail{
+
+  /** Free list of memory blocks, one list per thread and per Key.
+  * The threads never share a list so no synchronization is needed.
+  * All the blocks of a list have the size of the first block requested.
+  */
+  template <class Key>
+  class block_cache
+  : public thread_cache<block_cache<Key>>
+  {
+  public:
+    ~block_cache()
+    {
+      clear();
+    }
+
+    static void* allocate_unpooled(std::size_t size)
+    {
+      return ::operator new(size);
+    }
+
+    void* allocate(std::size_t size)
+    {
+      if(block_size_ == 0)
+      {
+        block_size_ = size;
+      }
+      if(size != block_size_ || free_list_.empty())
+      {
+        return ::operator new(size);
+      }
+      void* block = free_list_.back();
+      free_list_.pop_back();
+      return block;
+    }
+
+    void deallocate(void* block, std::size_t size)
+    {
+      if(size == block_size_ && free_list_.size() < max_cached_)
+      {
+        free_list_.push_back(block);
+      }
+      else
+      {
+        ::operator delete(block);
+      }
+    }
+
+    void clear()
+    {
+      for(void* block : free_list_)
+      {
+        ::operator delete(block);
+      }
+      free_list_.clear();
+    }
+
+    std::size_t size() const { return free_list_.size(); }
+
+    std::size_t max_cached() const { return max_cached_; }
+    void max_cached(std::size_t n) { max_cached_ = n; }
+
+  private:
+    friend class thread_cache<block_cache<Key>>;
+
+    block_cache()
+    : block_size_(0)
+    , max_cached_(1024)
+    {}
+
+    std::vector<void*> free_list_;
+    std::size_t block_size_;
+    std::size_t max_cached_;
+  };
+
+  /** Allocator drawing its memory from the block_cache of the calling thread.
+  * std::allocate_shared rebinds it to its internal node type, so the object and
+  * its control block are recycled together in a single block.
+  */
+  template <class T, class Key>
+  class pool_allocator
+  {
+  public:
+    using value_type = T;
+
+    template <class U>
+    struct rebind
+    {
+      using other = pool_allocator<U, Key>;
+    };
+
+    pool_allocator() = default;
+
+    template <class U>
+    pool_allocator(const pool_allocator<U, Key>&) {}
+
+    T* allocate(std::size_t n)
+    {
+      return static_cast<T*>(block_cache<Key>::allocate_local(sizeof(T) * n));
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+      block_cache<Key>::deallocate_local(p, sizeof(T) * n);
+    }
+
+    template <class U>
+    bool operator==(const pool_allocator<U, Key>&) const { return true; }
+
+    template <class U>
+    bool operator!=(const pool_allocator<U, Key>&) const { return false; }
+  };
+} // namespace detail
+
+/** Hand out network_transfer objects whose memory is recycled.
+*
+* A transfer obtained with make() is an ordinary shared network_transfer, it
+* is built in place for every message (the buffer provider and the observer
+* are not movable, so they can't be reset). When the last reference
+* is dropped, usually after transfer_complete or transfer_error has been
+* dispatched, its memory (including the shared_ptr control block) goes back
+* to a free list local to the current thread. The next transfer of the same
+* type created on this thread reuses it, so the server_mt workers never
+* contend on the pool. A transfer released after the exit of the thread
+* cache (by the destructor of a thread_local object) is simply freed.
+*/
+template <class BufferProvider, class Observer, class Socket, class TimerPolicy = no_timer>
+class transfer_pool
+{
+public:
+  using transfer_type = network_transfer<BufferProvider, Observer, Socket, TimerPolicy>;
+  using transfer_ptr = std::shared_ptr<transfer_type>;
+  using socket_ptr = typename transfer_type::socket_ptr;
+
+private:
+  using allocator_type = detail::pool_allocator<transfer_type, transfer_type>;
+  using cache_type = detail::block_cache<transfer_type>;
+
+public:
+  template <class ObserverType, class... BufferProviderArgs>
+  static transfer_ptr make(const socket_ptr& socket, ObserverType&& observer, BufferProviderArgs&&... args)
+  {
+    return std::allocate_shared<transfer_type>(allocator_type(),
+      socket, std::forward<ObserverType>(observer), std::forward<BufferProviderArgs>(args)...);
+  }
+
+  /** Set the maximum number of free transfers kept by the calling thread.
+  */
+  static void max_cached(std::size_t n)
+  {
+    if(cache_type* cache = cache_type::local())
+    {
+      cache->max_cached(n);
+    }
+  }
+
+  /** @return the number of free transfers kept by the calling thread.
+  */
+  static std::size_t cached()
+  {
+    cache_type* cache = cache_type::local();
+    return cache != nullptr ? cache->size() : 0;
+  }
+
+  /** Release the free transfers kept by the calling thread.
+  */
+  static void clear()
+  {
+    if(cache_type* cache = cache_type::local())
+    {
+      cache->clear();
+    }
+  }
+};
+
+template <class BufferTraits, class TimerPolicy = no_timer, class Socket, class Observer, class... BufferArgs>
+std::shared_ptr<
+  network_transfer<
+    typename BufferTraits::type, 
+    Observer,
+    Socket,
+    TimerPolicy>>
+make_pooled_transfer(const std::shared_ptr<Socket>& socket, Observer&& observer, BufferArgs&&... args)
+{
+  return transfer_pool<
+      typename BufferTraits::type, 
+      Observer,
+      Socket,
+      TimerPolicy>::make(
+    socket, std::forward<Observer>(observer), std::forward<BufferArgs>(args)...);
+}
+
+template <class BufferTraits, class TimerPolicy = no_timer, class Socket, class Observer, class... BufferArgs>
+std::shared_ptr<
+  network_transfer<
+    typename BufferTraits::type, 
+    Observer&,
+    Socket,
+    TimerPolicy>>
+make_pooled_transfer(const std::shared_ptr<Socket>& socket, std::reference_wrapper<Observer> observer, BufferArgs&&... args)
+{
+  return transfer_pool<
+      typename BufferTraits::type, 
+      Observer&,
+      Socket,
+      TimerPolicy>::make(
+    socket, observer.get(), std::forward<BufferArgs>(args)...);
+}
+
+} // namespace neev
+
+#endif // NEEV_TRANSFER_POOL_HPP
@@ -0,0 +1,122 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#include <neev/buffer/checked_buffer.hpp>
+#include <boost/test/minimal.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <cstring>
+#include <string>
+
+using socket_type = boost::asio::local::stream_protocol::socket;
+using socket_ptr = std::shared_ptr<socket_type>;
+
+struct receive_observer
+{
+  using events_type = neev::events<neev::transfer_complete, neev::transfer_error>;
+
+  receive_observer(std::string& data, boost::system::error_code& error)
+  : data_(data)
+  , error_(error)
+  {}
+
+  void transfer_complete(std::string& data, neev::receive_op)
+  {
+    data_ = data;
+  }
+
+  void transfer_error(const boost::system::error_code& error)
+  {
+    error_ = error;
+  }
+
+ private:
+  std::string& data_;
+  boost::system::error_code& error_;
+};
+
+struct send_observer
+{
+  using events_type = neev::events<>;
+};
+
+// Check value of the CRC32C (RFC 3720, appendix B.4).
+void crc32c_check_value()
+{
+  const char digits[] = "123456789";
+  BOOST_CHECK(neev::crc32c(0, digits, 9) == 0xe3069283);
+  // The checksum can be computed in several steps.
+  BOOST_CHECK(neev::crc32c(neev::crc32c(0, digits, 4), digits + 4, 5) == 0xe3069283);
+  BOOST_CHECK(neev::crc32c(0, digits, 0) == 0);
+}
+
+void checked_frame()
+{
+  boost::asio::io_service io_service;
+  socket_ptr sender = std::make_shared<socket_type>(io_service);
+  socket_ptr receiver = std::make_shared<socket_type>(io_service);
+  boost::asio::local::connect_pair(*sender, *receiver);
+
+  std::string data;
+  boost::system::error_code error;
+  neev::make_transfer<neev::checked_prefixed32_buffer<neev::receive_op>>(
+    receiver, receive_observer(data, error))->async_transfer();
+  neev::make_transfer<neev::checked_prefixed32_buffer<neev::send_op>>(
+    sender, send_observer(), std::string("123456789"))->async_transfer();
+  io_service.run();
+  BOOST_CHECK(!error);
+  BOOST_CHECK(data == "123456789");
+}
+
+// The checksum is extended chunk by chunk, the last chunk being shorter.
+void chunked_frame()
+{
+  boost::asio::io_service io_service;
+  socket_ptr sender = std::make_shared<socket_type>(io_service);
+  socket_ptr receiver = std::make_shared<socket_type>(io_service);
+  boost::asio::local::connect_pair(*sender, *receiver);
+
+  std::string data;
+  boost::system::error_code error;
+  neev::make_transfer<neev::checked_prefixed32_buffer<neev::receive_op>>(
+    receiver, receive_observer(data, error), std::size_t(4))->async_transfer();
+  neev::make_transfer<neev::checked_prefixed32_buffer<neev::send_op>>(
+    sender, send_observer(), std::string("0123456789abcdefghij"))->async_transfer();
+  io_service.run();
+  BOOST_CHECK(!error);
+  BOOST_CHECK(data == "0123456789abcdefghij");
+}
+
+// A payload altered on the way fails the transfer.
+void corrupted_frame()
+{
+  boost::asio::io_service io_service;
+  socket_ptr sender = std::make_shared<socket_type>(io_service);
+  socket_ptr receiver = std::make_shared<socket_type>(io_service);
+  boost::asio::local::connect_pair(*sender, *receiver);
+
+  std::string data;
+  boost::system::error_code error;
+  neev::make_transfer<neev::checked_prefixed32_buffer<neev::receive_op>>(
+    receiver, receive_observer(data, error), std::size_t(4))->async_transfer();
+
+  std::uint32_t prefix = neev::hton<std::uint32_t>(9);
+  std::uint32_t checksum = neev::hton<std::uint32_t>(0xe3069283);
+  std::string frame(reinterpret_cast<const char*>(&prefix), sizeof(prefix));
+  frame += "123456780";
+  frame.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+  boost::asio::write(*sender, boost::asio::buffer(frame));
+  io_service.run();
+  BOOST_CHECK(error == neev::error::checksum_mismatch);
+  BOOST_CHECK(data.empty());
+}
+
+int test_main(int, char *[])
+{
+  crc32c_check_value();
+  checked_frame();
+  chunked_frame();
+  corrupted_frame();
+  return 0;
+}
@@ -0,0 +1,170 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#include <neev/buffer/delimited_buffer.hpp>
+#include <boost/test/minimal.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <string>
+#include <vector>
+
+using socket_type = boost::asio::local::stream_protocol::socket;
+using socket_ptr = std::shared_ptr<socket_type>;
+using messages = std::vector<std::string>;
+
+struct receive_observer
+{
+  using events_type = neev::events<neev::transfer_complete, neev::transfer_error>;
+
+  receive_observer(messages& received, boost::system::error_code& error)
+  : received_(received)
+  , error_(error)
+  {}
+
+  void transfer_complete(std::string& data, neev::receive_op)
+  {
+    received_.push_back(data);
+  }
+
+  void transfer_error(const boost::system::error_code& error)
+  {
+    error_ = error;
+  }
+
+ private:
+  messages& received_;
+  boost::system::error_code& error_;
+};
+
+struct connected_pair
+{
+  connected_pair(boost::asio::io_service& io_service)
+  : sender(std::make_shared<socket_type>(io_service))
+  , receiver(std::make_shared<socket_type>(io_service))
+  {
+    boost::asio::local::connect_pair(*sender, *receiver);
+  }
+
+  void write(const std::string& bytes)
+  {
+    boost::asio::write(*sender, boost::asio::buffer(bytes));
+  }
+
+  socket_ptr sender;
+  socket_ptr receiver;
+};
+
+// The first read ends in the middle of the delimiter.
+void delimiter_across_reads()
+{
+  boost::asio::io_service io_service;
+  connected_pair sockets(io_service);
+  messages received;
+  boost::system::error_code error;
+  neev::make_transfer<neev::delimited_buffer<neev::receive_op>>(
+    sockets.receiver, receive_observer(received, error), std::string("\r\n"))->async_transfer();
+
+  sockets.write("hello\r");
+  io_service.poll();
+  BOOST_CHECK(received.empty());
+  sockets.write("\n");
+  io_service.run();
+  BOOST_CHECK(!error);
+  BOOST_CHECK(received == messages{"hello"});
+}
+
+// A partial match of the delimiter is part of the message.
+void multi_byte_delimiter()
+{
+  boost::asio::io_service io_service;
+  connected_pair sockets(io_service);
+  messages received;
+  boost::system::error_code error;
+  neev::make_transfer<neev::delimited_buffer<neev::receive_op>>(
+    sockets.receiver, receive_observer(received, error), std::string("<END>"))->async_transfer();
+
+  sockets.write("a<EN<b<END>");
+  io_service.run();
+  BOOST_CHECK(!error);
+  BOOST_CHECK(received == messages{"a<EN<b"});
+}
+
+// The messages after the first one are already received, they complete
+// without reading from the socket.
+void messages_in_one_read()
+{
+  boost::asio::io_service io_service;
+  connected_pair sockets(io_service);
+  messages received;
+  boost::system::error_code error;
+  neev::make_transfer<neev::delimited_buffer<neev::receive_op>>(
+    sockets.receiver, receive_observer(received, error), std::string("\n"))->async_receive_loop();
+
+  sockets.write("one\ntwo\n\nthree\n");
+  sockets.sender->close();
+  io_service.run();
+  BOOST_CHECK(error == boost::asio::error::eof);
+  BOOST_CHECK((received == messages{"one", "two", "", "three"}));
+}
+
+// The bytes received after the first message are given to the next transfer.
+void leftover_to_next_transfer()
+{
+  boost::asio::io_service io_service;
+  connected_pair sockets(io_service);
+  messages received;
+  boost::system::error_code error;
+  auto first = neev::make_transfer<neev::delimited_buffer<neev::receive_op>>(
+    sockets.receiver, receive_observer(received, error), std::string("\n"));
+  first->async_transfer();
+
+  sockets.write("first\nsecond\nthi");
+  io_service.run();
+  BOOST_CHECK(received == messages{"first"});
+  BOOST_CHECK(first->buffer_provider().leftover() == 10);
+
+  std::string leftover = first->buffer_provider().take_leftover();
+  BOOST_CHECK(first->buffer_provider().leftover() == 0);
+  auto second = neev::make_transfer<neev::delimited_buffer<neev::receive_op>>(
+    sockets.receiver, receive_observer(received, error), std::string("\n"),
+    std::size_t(neev::delimited_receive_buffer::default_max_length),
+    std::size_t(neev::delimited_receive_buffer::default_read_size), std::move(leftover));
+  second->async_transfer();
+  io_service.reset();
+  io_service.run();
+  BOOST_CHECK(!error);
+  BOOST_CHECK((received == messages{"first", "second"}));
+  BOOST_CHECK(second->buffer_provider().leftover() == 3);
+
+  // The seed is the start of the message, nothing is left over yet.
+  neev::delimited_receive_buffer seeded(std::string("\n"), 64, 16, std::string("abc"));
+  BOOST_CHECK(seeded.leftover() == 0);
+}
+
+// A message of max_length bytes is accepted, one more byte is rejected.
+void message_too_large()
+{
+  boost::asio::io_service io_service;
+  connected_pair sockets(io_service);
+  messages received;
+  boost::system::error_code error;
+  neev::make_transfer<neev::delimited_buffer<neev::receive_op>>(
+    sockets.receiver, receive_observer(received, error), std::string("\n"),
+    std::size_t(8), std::size_t(4))->async_receive_loop();
+
+  sockets.write("12345678\n123456789\n");
+  io_service.run();
+  BOOST_CHECK(error == neev::error::message_too_large);
+  BOOST_CHECK(received == messages{"12345678"});
+}
+
+int test_main(int, char *[])
+{
+  delimiter_across_reads();
+  multi_byte_delimiter();
+  messages_in_one_read();
+  leftover_to_next_transfer();
+  message_too_large();
+  return 0;
+}
@@ -0,0 +1,186 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#include <neev/buffer/file_buffer.hpp>
+#include <neev/buffer/prefixed_buffer.hpp>
+#include <boost/test/minimal.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+using socket_type = boost::asio::local::stream_protocol::socket;
+using socket_ptr = std::shared_ptr<socket_type>;
+
+struct transfer_result
+{
+  bool complete = false;
+  std::string data;
+  boost::system::error_code error;
+};
+
+struct send_observer
+{
+  using events_type = neev::events<neev::transfer_complete, neev::transfer_error>;
+
+  send_observer(transfer_result& result)
+  : result_(result)
+  {}
+
+  void transfer_complete(const neev::file_range&, neev::send_op)
+  {
+    result_.complete = true;
+  }
+
+  void transfer_error(const boost::system::error_code& error)
+  {
+    result_.error = error;
+  }
+
+ private:
+  transfer_result& result_;
+};
+
+struct receive_observer
+{
+  using events_type = neev::events<neev::transfer_complete, neev::transfer_error>;
+
+  receive_observer(transfer_result& result)
+  : result_(result)
+  {}
+
+  void transfer_complete(std::string& data, neev::receive_op)
+  {
+    result_.complete = true;
+    result_.data = data;
+  }
+
+  void transfer_error(const boost::system::error_code& error)
+  {
+    result_.error = error;
+  }
+
+ private:
+  transfer_result& result_;
+};
+
+struct connected_pair
+{
+  connected_pair(boost::asio::io_service& io_service)
+  : sender(std::make_shared<socket_type>(io_service))
+  , receiver(std::make_shared<socket_type>(io_service))
+  {
+    boost::asio::local::connect_pair(*sender, *receiver);
+  }
+
+  socket_ptr sender;
+  socket_ptr receiver;
+};
+
+// Unlinked temporary file, closed with the object.
+struct temporary_file
+{
+  temporary_file(const std::string& content)
+  {
+    char path[] = "/tmp/neev_file_buffer_XXXXXX";
+    fd = ::mkstemp(path);
+    BOOST_REQUIRE(fd >= 0);
+    ::unlink(path);
+    BOOST_REQUIRE(::write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size()));
+  }
+
+  ~temporary_file()
+  {
+    ::close(fd);
+  }
+
+  int fd;
+};
+
+std::string file_content(std::size_t size)
+{
+  std::string content(size, '\0');
+  for(std::size_t i = 0; i < size; ++i)
+  {
+    content[i] = static_cast<char>(i % 251);
+  }
+  return content;
+}
+
+// The socket buffer is much smaller than the region, sendfile is called
+// many times and every call resumes where the previous one stopped.
+void partial_sendfile()
+{
+  const std::size_t offset = 1000;
+  const std::size_t size = 1 << 20;
+  std::string content = file_content(offset + size + 1000);
+  temporary_file file(content);
+
+  boost::asio::io_service io_service;
+  connected_pair sockets(io_service);
+  sockets.sender->set_option(boost::asio::socket_base::send_buffer_size(4096));
+  sockets.receiver->set_option(boost::asio::socket_base::receive_buffer_size(4096));
+
+  transfer_result sent;
+  transfer_result received;
+  neev::make_transfer<neev::prefixed32_buffer<neev::receive_op>>(
+    sockets.receiver, receive_observer(received))->async_transfer();
+  neev::make_transfer<neev::file32_buffer<neev::send_op>>(
+    sockets.sender, send_observer(sent), file.fd, std::uint64_t(offset), size)->async_transfer();
+  io_service.run();
+
+  BOOST_CHECK(!sent.error);
+  BOOST_CHECK(sent.complete);
+  BOOST_CHECK(!received.error);
+  BOOST_CHECK(received.complete);
+  BOOST_CHECK(received.data == content.substr(offset, size));
+  // The offset of the file descriptor is left untouched.
+  BOOST_CHECK(::lseek(file.fd, 0, SEEK_CUR) == static_cast<off_t>(content.size()));
+}
+
+// The whole file, without prefix.
+void raw_file()
+{
+  std::string content = file_content(10000);
+  temporary_file file(content);
+
+  boost::asio::io_service io_service;
+  connected_pair sockets(io_service);
+  transfer_result sent;
+  neev::make_transfer<neev::raw_file_buffer<neev::send_op>>(
+    sockets.sender, send_observer(sent), file.fd)->async_transfer();
+  io_service.run();
+  BOOST_CHECK(!sent.error);
+  BOOST_CHECK(sent.complete);
+
+  std::string data(content.size(), '\0');
+  boost::asio::read(*sockets.receiver, boost::asio::buffer(&data[0], data.size()));
+  BOOST_CHECK(data == content);
+}
+
+// The peer is closed, sending the header fails and the error reaches the observer.
+void header_error()
+{
+  temporary_file file(file_content(100));
+
+  boost::asio::io_service io_service;
+  connected_pair sockets(io_service);
+  sockets.receiver->close();
+
+  transfer_result sent;
+  neev::make_transfer<neev::file32_buffer<neev::send_op>>(
+    sockets.sender, send_observer(sent), file.fd)->async_transfer();
+  io_service.run();
+  BOOST_CHECK(!sent.complete);
+  BOOST_CHECK(sent.error == boost::asio::error::broken_pipe);
+}
+
+int test_main(int, char *[])
+{
+  partial_sendfile();
+  raw_file();
+  header_error();
+  return 0;
+}
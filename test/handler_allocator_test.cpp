@@ -0,0 +1,152 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#include <neev/handler_allocator.hpp>
+#include <neev/network_transfer.hpp>
+#include <boost/test/minimal.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <cstdlib>
+#include <string>
+#include <new>
+
+static std::size_t allocations = 0;
+
+void* operator new(std::size_t size)
+{
+  ++allocations;
+  if(void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+// The block serves one request at a time, the others go to operator new.
+void block_reuse()
+{
+  neev::handler_memory<64> memory;
+  std::size_t before = allocations;
+  void* block = memory.allocate(64);
+  BOOST_CHECK(allocations == before);
+  void* overflow = memory.allocate(16);
+  BOOST_CHECK(allocations == before + 1);
+  BOOST_CHECK(overflow != block);
+  memory.deallocate(overflow);
+  memory.deallocate(block);
+  BOOST_CHECK(memory.allocate(32) == block);
+  memory.deallocate(block);
+  void* large = memory.allocate(65);
+  BOOST_CHECK(allocations == before + 2);
+  memory.deallocate(large);
+}
+
+static const std::size_t chunk_length = 16;
+static const std::size_t chunk_count = 64;
+
+// Receive chunk_count chunks of chunk_length bytes, one chunk at a time.
+class chunked_receive_buffer
+{
+ public:
+  using data_type = std::string;
+  using buffer_type = boost::asio::mutable_buffers_1;
+  using transfer_category = neev::receive_op;
+
+  chunked_receive_buffer(std::size_t& allocations_after_first_chunk)
+  : data_(chunk_length * chunk_count, 0)
+  , current_(0)
+  , allocations_after_first_chunk_(allocations_after_first_chunk)
+  {}
+
+  boost::optional<std::size_t> size() const { return data_.size(); }
+  std::size_t chunk_size() const { return chunk_length; }
+  bool is_chunk_complete(std::size_t) const { return false; }
+  bool has_next_chunk() const { return current_ + 1 < chunk_count; }
+
+  buffer_type chunk()
+  {
+    return boost::asio::buffer(&data_[current_ * chunk_length], chunk_length);
+  }
+
+  void next_chunk()
+  {
+    if(current_ == 0)
+      allocations_after_first_chunk_ = allocations;
+    ++current_;
+  }
+
+  data_type& data() { return data_; }
+
+ private:
+  data_type data_;
+  std::size_t current_;
+  std::size_t& allocations_after_first_chunk_;
+};
+
+struct chunked_buffer
+{
+  using type = chunked_receive_buffer;
+};
+
+struct receive_observer
+{
+  using events_type = neev::events<neev::transfer_complete, neev::transfer_error>;
+
+  receive_observer(std::size_t& allocations_at_completion, bool& completed)
+  : allocations_at_completion_(allocations_at_completion)
+  , completed_(completed)
+  {}
+
+  void transfer_complete(const std::string& data, neev::receive_op)
+  {
+    allocations_at_completion_ = allocations;
+    completed_ = (data == std::string(chunk_length * chunk_count, 'x'));
+  }
+
+  void transfer_error(const boost::system::error_code&)
+  {
+    completed_ = false;
+  }
+
+ private:
+  std::size_t& allocations_at_completion_;
+  bool& completed_;
+};
+
+// Once the first operation is done, the next ones use the block of the
+// transfer: receiving the other chunks doesn't allocate.
+void transfer_operations()
+{
+  using socket_type = boost::asio::local::stream_protocol::socket;
+
+  boost::asio::io_service io_service;
+  auto sender = std::make_shared<socket_type>(io_service);
+  auto receiver = std::make_shared<socket_type>(io_service);
+  boost::asio::local::connect_pair(*sender, *receiver);
+
+  std::string payload(chunk_length * chunk_count, 'x');
+  boost::asio::write(*sender, boost::asio::buffer(payload));
+
+  std::size_t allocations_after_first_chunk = 0;
+  std::size_t allocations_at_completion = 0;
+  bool completed = false;
+  neev::make_transfer<chunked_buffer>(receiver,
+    receive_observer(allocations_at_completion, completed),
+    std::ref(allocations_after_first_chunk))->async_transfer();
+  io_service.run();
+
+  BOOST_REQUIRE(completed);
+  BOOST_CHECK(allocations_after_first_chunk != 0);
+  BOOST_CHECK(allocations_at_completion == allocations_after_first_chunk);
+}
+
+int test_main(int, char *[])
+{
+  block_reuse();
+  transfer_operations();
+  return 0;
+}
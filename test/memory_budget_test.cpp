@@ -0,0 +1,213 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#include <neev/buffer/budgeted_buffer.hpp>
+#include <neev/buffer/prefixed_buffer.hpp>
+#include <boost/test/minimal.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <string>
+
+using socket_type = boost::asio::local::stream_protocol::socket;
+using socket_ptr = std::shared_ptr<socket_type>;
+
+static const std::size_t limit = 100;
+
+struct receive_observer
+{
+  using events_type = neev::events<neev::transfer_complete, neev::transfer_error,
+    neev::transfer_paused, neev::transfer_resumed>;
+
+  receive_observer(boost::system::error_code& error, bool& paused, bool& resumed,
+    neev::budgeted_bytes& message)
+  : error_(error)
+  , paused_(paused)
+  , resumed_(resumed)
+  , message_(message)
+  {}
+
+  // The message keeps its memory until it is dropped.
+  void transfer_complete(neev::budgeted_bytes& message, neev::receive_op)
+  {
+    message_ = std::move(message);
+  }
+
+  void transfer_error(const boost::system::error_code& error)
+  {
+    error_ = error;
+  }
+
+  void transfer_paused()
+  {
+    paused_ = true;
+  }
+
+  void transfer_resumed()
+  {
+    resumed_ = true;
+  }
+
+ private:
+  boost::system::error_code& error_;
+  bool& paused_;
+  bool& resumed_;
+  neev::budgeted_bytes& message_;
+};
+
+struct send_observer
+{
+  using events_type = neev::events<>;
+};
+
+template <class TimerPolicy = neev::no_timer>
+struct paused_receive
+{
+  using transfer_type = neev::network_transfer<
+    neev::budgeted_prefixed_receive_buffer<std::uint32_t>, receive_observer, socket_type, TimerPolicy>;
+
+  // Receive a message of limit / 2 bytes, it is paused when the budget is
+  // already fully used.
+  paused_receive(boost::asio::io_service& io_service, const std::shared_ptr<neev::memory_budget>& budget)
+  : sender(std::make_shared<socket_type>(io_service))
+  , receiver(std::make_shared<socket_type>(io_service))
+  , paused(false)
+  , resumed(false)
+  {
+    boost::asio::local::connect_pair(*sender, *receiver);
+    transfer = neev::make_transfer<neev::budgeted_prefixed32_buffer<neev::receive_op>, TimerPolicy>(
+      receiver, receive_observer(error, paused, resumed, message), std::make_shared<neev::memory_account>(budget));
+    neev::make_transfer<neev::prefixed32_buffer<neev::send_op>>(sender, send_observer(),
+      std::string(limit / 2, 'x'))->async_transfer();
+  }
+
+  socket_ptr sender;
+  socket_ptr receiver;
+  std::shared_ptr<transfer_type> transfer;
+  boost::system::error_code error;
+  bool paused;
+  bool resumed;
+  neev::budgeted_bytes message;
+};
+
+// A paused transfer resumes once memory is released, the memory of the
+// message goes back to the budget when the message is dropped.
+void resume_when_released()
+{
+  boost::asio::io_service io_service;
+  auto budget = std::make_shared<neev::memory_budget>(limit, limit, limit);
+  auto holder = std::make_shared<neev::memory_account>(budget);
+  BOOST_REQUIRE(holder->acquire(limit, []{}));
+
+  paused_receive<> receive(io_service, budget);
+  receive.transfer->async_transfer();
+  io_service.run();
+  BOOST_REQUIRE(receive.paused);
+  BOOST_CHECK(!receive.resumed);
+  BOOST_CHECK(receive.message.empty());
+
+  holder->release(limit);
+  io_service.reset();
+  io_service.run();
+  BOOST_CHECK(!receive.error);
+  BOOST_CHECK(receive.resumed);
+  BOOST_CHECK(std::string(receive.message.begin(), receive.message.end()) == std::string(limit / 2, 'x'));
+  BOOST_CHECK(budget->used() == limit / 2);
+
+  receive.message = neev::budgeted_bytes();
+  BOOST_CHECK(budget->used() == 0);
+}
+
+// A message above max_message_size() fails without waiting for memory.
+void message_too_large()
+{
+  boost::asio::io_service io_service;
+  auto budget = std::make_shared<neev::memory_budget>(limit, limit, limit / 4);
+
+  paused_receive<> receive(io_service, budget);
+  receive.transfer->async_transfer();
+  io_service.run();
+  BOOST_CHECK(receive.error == neev::error::message_too_large);
+  BOOST_CHECK(!receive.paused);
+  BOOST_CHECK(budget->used() == 0);
+  BOOST_CHECK(budget->waiting() == 0);
+}
+
+// A paused transfer cancelled leaves the waiting queue and reports the cancellation.
+void cancel_while_waiting()
+{
+  boost::asio::io_service io_service;
+  auto budget = std::make_shared<neev::memory_budget>(limit, limit, limit);
+  auto holder = std::make_shared<neev::memory_account>(budget);
+  BOOST_REQUIRE(holder->acquire(limit, []{}));
+
+  paused_receive<> receive(io_service, budget);
+  receive.transfer->async_transfer();
+  io_service.run();
+  BOOST_REQUIRE(receive.paused);
+  BOOST_CHECK(budget->waiting() == 1);
+
+  boost::system::error_code ignore;
+  receive.transfer->cancel(ignore);
+  io_service.reset();
+  io_service.run();
+  BOOST_CHECK(receive.error == boost::asio::error::operation_aborted);
+  BOOST_CHECK(budget->waiting() == 0);
+
+  holder->release(limit);
+  BOOST_CHECK(budget->used() == 0);
+}
+
+// A transfer cancelled once its memory is granted, but before it is resumed,
+// gives the memory back.
+void cancel_before_resume()
+{
+  boost::asio::io_service io_service;
+  auto budget = std::make_shared<neev::memory_budget>(limit, limit, limit);
+  auto holder = std::make_shared<neev::memory_account>(budget);
+  BOOST_REQUIRE(holder->acquire(limit, []{}));
+
+  paused_receive<> receive(io_service, budget);
+  receive.transfer->async_transfer();
+  io_service.run();
+  BOOST_REQUIRE(receive.paused);
+
+  // The resume is posted but not run before the cancellation.
+  holder->release(limit);
+  BOOST_CHECK(budget->used() == limit / 2);
+  boost::system::error_code ignore;
+  receive.transfer->cancel(ignore);
+  io_service.reset();
+  io_service.run();
+  BOOST_CHECK(receive.error == boost::asio::error::operation_aborted);
+  BOOST_CHECK(budget->used() == 0);
+}
+
+// A paused transfer timing out leaves the waiting queue.
+void timeout_while_waiting()
+{
+  boost::asio::io_service io_service;
+  auto budget = std::make_shared<neev::memory_budget>(limit, limit, limit);
+  auto holder = std::make_shared<neev::memory_account>(budget);
+  BOOST_REQUIRE(holder->acquire(limit, []{}));
+
+  paused_receive<neev::wheel_timer> receive(io_service, budget);
+  receive.transfer->async_transfer(boost::posix_time::milliseconds(20));
+  io_service.run();
+  BOOST_CHECK(receive.paused);
+  BOOST_CHECK(receive.error == boost::asio::error::timed_out);
+  BOOST_CHECK(budget->waiting() == 0);
+
+  holder->release(limit);
+  BOOST_CHECK(budget->used() == 0);
+}
+
+int test_main(int, char *[])
+{
+  resume_when_released();
+  message_too_large();
+  cancel_while_waiting();
+  cancel_before_resume();
+  timeout_while_waiting();
+  return 0;
+}
@@ -0,0 +1,148 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#include <neev/readahead_receiver.hpp>
+#include <boost/test/minimal.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <string>
+#include <vector>
+
+using socket_type = boost::asio::local::stream_protocol::socket;
+using socket_ptr = std::shared_ptr<socket_type>;
+using frames = std::vector<std::string>;
+
+struct receive_observer
+{
+  using events_type = neev::events<neev::transfer_complete, neev::transfer_error>;
+
+  receive_observer(frames& received, boost::system::error_code& error)
+  : received_(received)
+  , error_(error)
+  {}
+
+  void transfer_complete(std::string& frame, neev::receive_op)
+  {
+    received_.push_back(frame);
+  }
+
+  void transfer_error(const boost::system::error_code& error)
+  {
+    error_ = error;
+  }
+
+ private:
+  frames& received_;
+  boost::system::error_code& error_;
+};
+
+struct connected_pair
+{
+  connected_pair(boost::asio::io_service& io_service)
+  : sender(std::make_shared<socket_type>(io_service))
+  , receiver(std::make_shared<socket_type>(io_service))
+  {
+    boost::asio::local::connect_pair(*sender, *receiver);
+  }
+
+  void write(const std::string& bytes)
+  {
+    boost::asio::write(*sender, boost::asio::buffer(bytes));
+  }
+
+  socket_ptr sender;
+  socket_ptr receiver;
+};
+
+std::string frame(const std::string& payload)
+{
+  std::uint16_t prefix = neev::hton(static_cast<std::uint16_t>(payload.size()));
+  return std::string(reinterpret_cast<const char*>(&prefix), sizeof(prefix)) + payload;
+}
+
+// All the frames of a read are delivered, in order.
+void frames_in_one_read()
+{
+  boost::asio::io_service io_service;
+  connected_pair sockets(io_service);
+  frames received;
+  boost::system::error_code error;
+  neev::make_readahead_receiver<std::uint16_t>(sockets.receiver,
+    receive_observer(received, error))->async_receive();
+
+  sockets.write(frame("one") + frame("") + frame("three"));
+  sockets.sender->close();
+  io_service.run();
+  BOOST_CHECK(error == boost::asio::error::eof);
+  BOOST_CHECK((received == frames{"one", "", "three"}));
+}
+
+// The bytes of a partial frame, prefix included, wait for the next read.
+void frame_across_reads()
+{
+  boost::asio::io_service io_service;
+  connected_pair sockets(io_service);
+  frames received;
+  boost::system::error_code error;
+  neev::make_readahead_receiver<std::uint16_t>(sockets.receiver,
+    receive_observer(received, error), 16)->async_receive();
+
+  std::string bytes = frame("first") + frame(std::string(40, 'x'));
+  sockets.write(bytes.substr(0, 8));
+  io_service.poll();
+  BOOST_CHECK((received == frames{"first"}));
+  sockets.write(bytes.substr(8, 20));
+  io_service.poll();
+  BOOST_CHECK(received.size() == 1);
+  sockets.write(bytes.substr(28));
+  sockets.sender->close();
+  io_service.run();
+  BOOST_CHECK(error == boost::asio::error::eof);
+  BOOST_CHECK((received == frames{"first", std::string(40, 'x')}));
+}
+
+// A frame larger than max_size stops the receiver.
+void frame_too_large()
+{
+  boost::asio::io_service io_service;
+  connected_pair sockets(io_service);
+  frames received;
+  boost::system::error_code error;
+  neev::make_readahead_receiver<std::uint16_t>(sockets.receiver,
+    receive_observer(received, error), 4096, 8)->async_receive();
+
+  sockets.write(frame("12345678") + frame("123456789") + frame("next"));
+  io_service.run();
+  BOOST_CHECK(error == neev::error::message_too_large);
+  BOOST_CHECK((received == frames{"12345678"}));
+}
+
+// A pending read is cancelled.
+void cancel()
+{
+  boost::asio::io_service io_service;
+  connected_pair sockets(io_service);
+  frames received;
+  boost::system::error_code error;
+  auto receiver = neev::make_readahead_receiver<std::uint16_t>(sockets.receiver,
+    receive_observer(received, error));
+  receiver->async_receive();
+  io_service.poll();
+
+  boost::system::error_code cancel_error;
+  receiver->cancel(cancel_error);
+  io_service.run();
+  BOOST_CHECK(!cancel_error);
+  BOOST_CHECK(error == boost::asio::error::operation_aborted);
+  BOOST_CHECK(received.empty());
+}
+
+int test_main(int, char *[])
+{
+  frames_in_one_read();
+  frame_across_reads();
+  frame_too_large();
+  cancel();
+  return 0;
+}
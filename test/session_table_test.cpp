@@ -0,0 +1,106 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#include <neev/server/session_table.hpp>
+#include <boost/test/minimal.hpp>
+#include <memory>
+#include <string>
+
+// An erased slot is reused with a new generation, the old handle finds nothing.
+void slot_reuse()
+{
+  neev::slot_map<std::string> map;
+  std::pair<std::uint32_t, std::uint32_t> first = map.insert("first");
+  BOOST_CHECK(map.erase(first.first, first.second));
+  BOOST_CHECK(!map.erase(first.first, first.second));
+
+  std::pair<std::uint32_t, std::uint32_t> second = map.insert("second");
+  BOOST_CHECK(second.first == first.first);
+  BOOST_CHECK(second.second != first.second);
+  BOOST_CHECK(map.find(first.first, first.second) == nullptr);
+  BOOST_CHECK(!map.erase(first.first, first.second));
+  BOOST_REQUIRE(map.find(second.first, second.second) != nullptr);
+  BOOST_CHECK(*map.find(second.first, second.second) == "second");
+  BOOST_CHECK(map.size() == 1);
+}
+
+// The last erased slot is reused first, the others keep their values.
+void free_list_order()
+{
+  neev::slot_map<int> map;
+  auto a = map.insert(1);
+  auto b = map.insert(2);
+  auto c = map.insert(3);
+  map.erase(a.first, a.second);
+  map.erase(c.first, c.second);
+  BOOST_CHECK(map.insert(4).first == c.first);
+  BOOST_CHECK(map.insert(5).first == a.first);
+  BOOST_CHECK(map.insert(6).first == 3);
+  BOOST_CHECK(*map.find(b.first, b.second) == 2);
+
+  int sum = 0;
+  map.for_each([&sum](std::uint32_t, std::uint32_t, int& value) { sum += value; });
+  BOOST_CHECK(sum == 2 + 4 + 5 + 6);
+}
+
+void shards()
+{
+  neev::session_table<int> table(2);
+  neev::session_id a = table.insert(0, 10);
+  neev::session_id b = table.insert(1, 20);
+  BOOST_CHECK(a.shard == 0 && b.shard == 1);
+  BOOST_CHECK(a.is_valid() && b.is_valid());
+  BOOST_CHECK(!neev::session_id().is_valid());
+  BOOST_CHECK(*table.find(a) == 10);
+  BOOST_CHECK(*table.find(b) == 20);
+  BOOST_CHECK(table.size() == 2);
+
+  BOOST_CHECK(table.erase(a));
+  BOOST_CHECK(!table.find(a));
+  neev::session_id c = table.insert(0, 30);
+  BOOST_CHECK(c.slot == a.slot && c != a);
+  BOOST_CHECK(!table.find(a));
+  BOOST_CHECK(!table.find(neev::session_id(2, 0, 1)));
+
+  int sum = 0;
+  table.for_each([&sum](const neev::session_id&, int& value) { sum += value; });
+  BOOST_CHECK(sum == 50);
+}
+
+// A table of weak pointers doesn't keep the values alive.
+void weak_sessions()
+{
+  neev::session_table<std::weak_ptr<int>> table;
+  auto value = std::make_shared<int>(1);
+  neev::session_id id = table.insert(0, value);
+  BOOST_CHECK(table.find(id)->lock() == value);
+  value.reset();
+  BOOST_CHECK(table.find(id)->expired());
+}
+
+// The expired sessions nobody erases don't grow the table without bound.
+void expired_sessions_swept()
+{
+  neev::session_table<std::weak_ptr<int>> table;
+  auto live = std::make_shared<int>(0);
+  neev::session_id live_id = table.insert(0, live, neev::expired_session());
+  for(int i = 0; i < 10000; ++i)
+  {
+    auto value = std::make_shared<int>(i);
+    table.insert(0, value, neev::expired_session());
+  }
+  BOOST_CHECK(table.size() <= 128);
+  BOOST_CHECK(table.find(live_id)->lock() == live);
+}
+
+int test_main(int, char *[])
+{
+  slot_reuse();
+  free_list_order();
+  shards();
+  weak_sessions();
+  expired_sessions_swept();
+  return 0;
+}
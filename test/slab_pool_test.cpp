@@ -0,0 +1,72 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#include <neev/slab_pool.hpp>
+#include <boost/test/minimal.hpp>
+#include <thread>
+
+using neev::detail::slab_cache;
+
+void size_classes()
+{
+  BOOST_CHECK(slab_cache::class_of(0) == 0);
+  BOOST_CHECK(slab_cache::class_of(64) == 0);
+  BOOST_CHECK(slab_cache::class_of(65) == 1);
+  BOOST_CHECK(slab_cache::class_size(slab_cache::classes - 1) != 0);
+  BOOST_CHECK(slab_cache::class_of(slab_cache::class_size(slab_cache::classes - 1) + 1) == slab_cache::unpooled);
+}
+
+// The block of released bytes is reused by the next bytes of the same class.
+void recycle()
+{
+  neev::slab_pool::clear();
+  neev::pooled_bytes bytes(100);
+  const char* address = bytes.data();
+  bytes = neev::pooled_bytes();
+  BOOST_CHECK(neev::slab_pool::cached_bytes() == 128);
+  neev::pooled_bytes other(120);
+  BOOST_CHECK(other.data() == address);
+  BOOST_CHECK(neev::slab_pool::cached_bytes() == 0);
+}
+
+// The blocks released beyond max_cached_bytes() are freed.
+void cache_limit()
+{
+  neev::slab_pool::clear();
+  std::size_t limit = neev::slab_pool::max_cached_bytes();
+  neev::slab_pool::max_cached_bytes(256);
+  {
+    neev::pooled_bytes a(200);
+    neev::pooled_bytes b(200);
+  }
+  BOOST_CHECK(neev::slab_pool::cached_bytes() == 256);
+  neev::slab_pool::max_cached_bytes(limit);
+  neev::slab_pool::clear();
+}
+
+// Bytes released by another thread go to the cache of that thread.
+void release_by_another_thread()
+{
+  neev::slab_pool::clear();
+  neev::pooled_bytes bytes(1000);
+  std::size_t cached_by_other = 0;
+  std::thread thread([&]()
+  {
+    bytes = neev::pooled_bytes();
+    cached_by_other = neev::slab_pool::cached_bytes();
+  });
+  thread.join();
+  BOOST_CHECK(cached_by_other == 1024);
+  BOOST_CHECK(neev::slab_pool::cached_bytes() == 0);
+}
+
+int test_main(int, char *[])
+{
+  size_classes();
+  recycle();
+  cache_limit();
+  release_by_another_thread();
+  return 0;
+}
@@ -0,0 +1,72 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#include <neev/transfer_pool.hpp>
+#include <neev/buffer/prefixed_buffer.hpp>
+#include <boost/test/minimal.hpp>
+#include <boost/asio.hpp>
+#include <string>
+#include <thread>
+
+using socket_type = boost::asio::ip::tcp::socket;
+using socket_ptr = std::shared_ptr<socket_type>;
+
+struct send_observer
+{
+  using events_type = neev::events<>;
+};
+
+using pool_type = neev::transfer_pool<neev::prefixed_send_buffer<std::uint32_t>, send_observer, socket_type>;
+
+static boost::asio::io_service io_service;
+
+pool_type::transfer_ptr make_transfer()
+{
+  return neev::make_pooled_transfer<neev::prefixed32_buffer<neev::send_op>>(
+    std::make_shared<socket_type>(io_service), send_observer(), std::string("neev"));
+}
+
+// The memory of a released transfer is reused by the next one.
+void recycle()
+{
+  pool_type::clear();
+  pool_type::transfer_ptr transfer = make_transfer();
+  pool_type::transfer_type* address = transfer.get();
+  transfer.reset();
+  BOOST_CHECK(pool_type::cached() == 1);
+  transfer = make_transfer();
+  BOOST_CHECK(pool_type::cached() == 0);
+  BOOST_CHECK(transfer.get() == address);
+}
+
+// Built before the cache of its thread, so destroyed after it.
+struct transfer_holder
+{
+  ~transfer_holder()
+  {
+    transfer.reset();
+    BOOST_CHECK(pool_type::cached() == 0);
+  }
+
+  pool_type::transfer_ptr transfer;
+};
+
+// A transfer released once the cache of its thread is destroyed is freed.
+void release_after_thread_cache()
+{
+  std::thread thread([]()
+  {
+    static thread_local transfer_holder holder;
+    holder.transfer = make_transfer();
+  });
+  thread.join();
+}
+
+int test_main(int, char *[])
+{
+  recycle();
+  release_after_thread_cache();
+  return 0;
+}
@@ -0,0 +1,165 @@
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE.txt
+//
+// (C) Copyright 2014 Pierre Talbot <ptalbot@hyc.io>
+
+#include <neev/buffer/varint_buffer.hpp>
+#include <boost/test/minimal.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <limits>
+#include <string>
+
+using socket_type = boost::asio::local::stream_protocol::socket;
+using socket_ptr = std::shared_ptr<socket_type>;
+
+struct receive_observer
+{
+  using events_type = neev::events<neev::transfer_complete, neev::transfer_error>;
+
+  receive_observer(std::string& data, boost::system::error_code& error)
+  : data_(data)
+  , error_(error)
+  {}
+
+  void transfer_complete(std::string& data, neev::receive_op)
+  {
+    data_ = data;
+  }
+
+  void transfer_error(const boost::system::error_code& error)
+  {
+    error_ = error;
+  }
+
+ private:
+  std::string& data_;
+  boost::system::error_code& error_;
+};
+
+struct send_observer
+{
+  using events_type = neev::events<>;
+};
+
+struct varint_receive
+{
+  varint_receive(std::size_t max_size = std::numeric_limits<std::size_t>::max())
+  : sender(std::make_shared<socket_type>(io_service))
+  , receiver(std::make_shared<socket_type>(io_service))
+  {
+    boost::asio::local::connect_pair(*sender, *receiver);
+    neev::make_transfer<neev::varint_prefixed_buffer<neev::receive_op>>(
+      receiver, receive_observer(data, error), max_size)->async_transfer();
+  }
+
+  void write(const std::string& bytes)
+  {
+    boost::asio::write(*sender, boost::asio::buffer(bytes));
+  }
+
+  boost::asio::io_service io_service;
+  socket_ptr sender;
+  socket_ptr receiver;
+  std::string data;
+  boost::system::error_code error;
+};
+
+std::string round_trip(const std::string& payload)
+{
+  varint_receive receive;
+  neev::make_transfer<neev::varint_prefixed_buffer<neev::send_op>>(
+    receive.sender, send_observer(), std::string(payload))->async_transfer();
+  receive.io_service.run();
+  BOOST_CHECK(!receive.error);
+  return receive.data;
+}
+
+void encoding()
+{
+  unsigned char out[neev::detail::max_varint_size];
+  BOOST_CHECK(neev::detail::encode_varint(0, out) == 1 && out[0] == 0);
+  BOOST_CHECK(neev::detail::encode_varint(127, out) == 1 && out[0] == 127);
+  BOOST_CHECK(neev::detail::encode_varint(300, out) == 2 && out[0] == 0xac && out[1] == 0x02);
+  BOOST_CHECK(neev::detail::encode_varint(std::numeric_limits<std::uint64_t>::max(), out)
+    == neev::detail::max_varint_size);
+}
+
+// Sizes below 128 take a one-byte prefix, the larger ones are received
+// with the start of the message in the prefix window.
+void one_and_two_byte_prefixes()
+{
+  BOOST_CHECK(round_trip("") == "");
+  BOOST_CHECK(round_trip(std::string(127, 'a')) == std::string(127, 'a'));
+  BOOST_CHECK(round_trip(std::string(128, 'b')) == std::string(128, 'b'));
+  BOOST_CHECK(round_trip(std::string(20000, 'c')) == std::string(20000, 'c'));
+}
+
+// The largest prefix (10 bytes) is decoded, the size is then too large.
+void ten_byte_prefix()
+{
+  std::string prefix(9, '\x80');
+  prefix += '\x01';
+  {
+    varint_receive receive(1000);
+    receive.write(prefix);
+    receive.io_service.run();
+    BOOST_CHECK(receive.error == neev::error::message_too_large);
+  }
+  {
+    varint_receive receive;
+    receive.write(prefix);
+    receive.io_service.run();
+    BOOST_CHECK(receive.error == neev::error::message_too_large);
+  }
+}
+
+void malformed_prefixes()
+{
+  // The 10th byte holds a single bit.
+  {
+    varint_receive receive;
+    std::string prefix(9, '\x80');
+    prefix += '\x02';
+    receive.write(prefix);
+    receive.io_service.run();
+    BOOST_CHECK(receive.error == neev::error::malformed_prefix);
+  }
+  // More than 10 bytes.
+  {
+    varint_receive receive;
+    receive.write(std::string(11, '\x80'));
+    receive.io_service.run();
+    BOOST_CHECK(receive.error == neev::error::malformed_prefix);
+  }
+  // 2 encoded in two bytes instead of one.
+  {
+    varint_receive receive;
+    receive.write(std::string("\x82\x00xy", 4));
+    receive.io_service.run();
+    BOOST_CHECK(receive.error == neev::error::malformed_prefix);
+    BOOST_CHECK(receive.data.empty());
+  }
+}
+
+// The second byte of the prefix arrives with another read.
+void prefix_across_reads()
+{
+  varint_receive receive;
+  receive.write("\xac");
+  receive.io_service.poll();
+  BOOST_CHECK(!receive.error);
+  receive.write("\x02" + std::string(300, 'z'));
+  receive.io_service.run();
+  BOOST_CHECK(!receive.error);
+  BOOST_CHECK(receive.data == std::string(300, 'z'));
+}
+
+int test_main(int, char *[])
+{
+  encoding();
+  one_and_two_byte_prefixes();
+  ten_byte_prefix();
+  malformed_prefixes();
+  prefix_across_reads();
+  return 0;
+}